@@ -0,0 +1,140 @@
+#include "BallCollider.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+// Below this many balls the narrow phase stays on the calling thread;
+// the fork/join cost outweighs the work.
+#define PARALLEL_MIN_BALLS 4096
+
+BallCollider::BallCollider(float maxRadius)
+    : cellSize(2.0f * maxRadius) {
+}
+
+void BallCollider::sort(const float *x, const float *y, const int *radius, int count) {
+    const int cellCount = cols * rows;
+    cellStart.assign(cellCount + 1, 0);
+    ballCell.resize(count);
+    for (int i = 0; i < count; ++i) {
+        int cx = std::clamp(static_cast<int>(x[i] / cellSize), 0, cols - 1);
+        int cy = std::clamp(static_cast<int>(y[i] / cellSize), 0, rows - 1);
+        ballCell[i] = cy * cols + cx;
+        cellStart[ballCell[i] + 1]++;
+    }
+    for (int c = 0; c < cellCount; ++c) {
+        cellStart[c + 1] += cellStart[c];
+    }
+
+    order.resize(count);
+    sx.resize(count);
+    sy.resize(count);
+    sr.resize(count);
+    for (int i = 0; i < count; ++i) {
+        int slot = cellStart[ballCell[i]]++;
+        order[slot] = i;
+        sx[slot] = x[i];
+        sy[slot] = y[i];
+        sr[slot] = static_cast<float>(radius[i]);
+    }
+    // The fill pass advanced every start to the next cell's start; shift back.
+    for (int c = cellCount; c > 0; --c) {
+        cellStart[c] = cellStart[c - 1];
+    }
+    cellStart[0] = 0;
+}
+
+long long BallCollider::relax(int count) {
+    dx.resize(count);
+    dy.resize(count);
+    std::atomic<long long> overlaps{0};
+
+    const int cellCount = cols * rows;
+    auto relaxCells = [&](int first, int last) {
+        long long touches = 0;
+        for (int cell = first; cell < last; ++cell) {
+            const int cx = cell % cols;
+            const int cy = cell / cols;
+            const int x0 = std::max(cx - 1, 0), x1 = std::min(cx + 1, cols - 1);
+            const int y0 = std::max(cy - 1, 0), y1 = std::min(cy + 1, rows - 1);
+
+            for (int k = cellStart[cell]; k < cellStart[cell + 1]; ++k) {
+                const float px = sx[k], py = sy[k], rk = sr[k];
+                const float massK = rk * rk;
+                float sumX = 0.0f, sumY = 0.0f;
+                int touching = 0;
+
+                for (int ny = y0; ny <= y1; ++ny) {
+                    // Neighbouring cells in a row are contiguous in the sorted order.
+                    const int begin = cellStart[ny * cols + x0];
+                    const int end = cellStart[ny * cols + x1 + 1];
+                    for (int t = begin; t < end; ++t) {
+                        const float ddx = px - sx[t];
+                        const float ddy = py - sy[t];
+                        const float reach = rk + sr[t];
+                        const float distSq = ddx * ddx + ddy * ddy;
+                        if (t == k || distSq >= reach * reach || distSq == 0.0f) continue;
+
+                        // Split the overlap by mass (area): the lighter ball moves more.
+                        const float dist = std::sqrt(distSq);
+                        const float massT = sr[t] * sr[t];
+                        const float push = (reach - dist) * massT / (massK + massT) / dist;
+                        sumX += ddx * push;
+                        sumY += ddy * push;
+                        touching++;
+                    }
+                }
+
+                dx[k] = touching ? sumX / touching : 0.0f;
+                dy[k] = touching ? sumY / touching : 0.0f;
+                touches += touching;
+            }
+        }
+        overlaps.fetch_add(touches, std::memory_order_relaxed);
+    };
+    if (jobs && count >= PARALLEL_MIN_BALLS) {
+        jobs->parallelFor(cellCount, std::max(1, cellCount / (jobs->threadCount() * 8)), relaxCells);
+    } else {
+        relaxCells(0, cellCount);
+    }
+
+    for (int k = 0; k < count; ++k) {
+        sx[k] += dx[k];
+        sy[k] += dy[k];
+    }
+    return overlaps.load(std::memory_order_relaxed) / 2;
+}
+
+void BallCollider::solve(float *x, float *y, const int *radius, int count,
+                         float width, float height, int iterations) {
+    contacts = 0;
+    if (count <= 0 || iterations <= 0) return;
+
+    cols = std::max(1, static_cast<int>(width / cellSize) + 1);
+    rows = std::max(1, static_cast<int>(height / cellSize) + 1);
+
+    for (int it = 0; it < iterations; ++it) {
+        // Re-sort every iteration: a correction can carry a ball into the
+        // next cell, and its new neighbours must be seen.
+        if (it > 0) {
+            for (int k = 0; k < count; ++k) {
+                x[order[k]] = sx[k];
+                y[order[k]] = sy[k];
+            }
+        }
+        sort(x, y, radius, count);
+        long long overlaps = relax(count);
+        if (it == 0) contacts = overlaps;
+    }
+
+    for (int k = 0; k < count; ++k) {
+        x[order[k]] = sx[k];
+        y[order[k]] = sy[k];
+    }
+}
+
+float ballBoxScale(int count, int maxRadius, float width, float height, float fill) {
+    // Mean of r^2 over 1..R is (R + 1)(2R + 1) / 6.
+    const double meanArea = 3.14159265358979 * (maxRadius + 1) * (2 * maxRadius + 1) / 6.0;
+    const double needed = count * meanArea / fill;
+    return static_cast<float>(std::max(1.0, std::sqrt(needed / (static_cast<double>(width) * height))));
+}
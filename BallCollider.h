@@ -0,0 +1,54 @@
+#ifndef BALLCOLLIDER_H
+#define BALLCOLLIDER_H
+#include <vector>
+
+#include "JobSystem.h"
+
+// Ball-ball contact resolution for free particles of varying radius.
+//
+// The broad phase is a grid of cells 2 * maxRadius wide over the box, so
+// touching balls are always in the same or neighbouring cells. Each
+// relaxation iteration re-sorts the balls by cell (counting sort), then
+// every ball gathers the mass-weighted push-out from all of its overlaps
+// and moves by their average (Jacobi). A ball only ever writes its own
+// correction, so the narrow phase runs on the job system without locks and
+// the result does not depend on the thread count.
+class BallCollider {
+public:
+  // Optional worker pool for the narrow phase; it runs serially when null.
+  JobSystem *jobs = nullptr;
+
+  explicit BallCollider(float maxRadius);
+
+  // Separates overlapping balls in place. Only x/y move, so the Verlet
+  // velocity (x - prevX) picks up the collision response on its own.
+  void solve(float *x, float *y, const int *radius, int count,
+             float width, float height, int iterations);
+
+  // Overlapping pairs found in the first iteration of the last solve().
+  long long lastContacts() const { return contacts; }
+
+private:
+  float cellSize;
+  int cols = 0;
+  int rows = 0;
+  long long contacts = 0;
+
+  std::vector<int> cellStart;  // cols * rows + 1 offsets into the sorted order
+  std::vector<int> order;      // ball index at each sorted slot
+  std::vector<int> ballCell;
+  // Sorted copies of the ball state, so neighbour scans read contiguous memory.
+  std::vector<float> sx, sy, sr;
+  std::vector<float> dx, dy;
+
+  void sort(const float *x, const float *y, const int *radius, int count);
+  long long relax(int count);
+};
+
+// Factor to grow a width x height box by (never below 1) so that `count`
+// balls with radii uniform over 1..maxRadius cover at most `fill` of it
+// and can settle without overlapping.
+float ballBoxScale(int count, int maxRadius, float width, float height, float fill = 0.5f);
+
+
+#endif //BALLCOLLIDER_H
@@ -0,0 +1,413 @@
+#include "ConstraintSolver.h"
+#include <algorithm>
+#include <cmath>
+
+#include "Physics.h"
+
+// Below this many active constraints a sweep stays on the calling thread;
+// the fork/join cost outweighs the work.
+#define PARALLEL_MIN_CONSTRAINTS 2048
+// Longest run of one line's constraints handled as a single block.
+#define BLOCK_CONSTRAINTS 1024
+
+const char *solverModeName(SolverMode mode) {
+    switch (mode) {
+        case SOLVER_PBD: return "pbd";
+        case SOLVER_XPBD: return "xpbd";
+        case SOLVER_DIRECT: return "direct";
+        case SOLVER_JACOBI: return "jacobi";
+        default: return "unknown";
+    }
+}
+
+void ConstraintSolver::build(const std::vector<Line*> &lines) {
+    colours[0].clear();
+    colours[1].clear();
+    blocks[0].clear();
+    blocks[1].clear();
+    lineConstraints.assign(lines.size(), 0);
+    chains.clear();
+    chainBlocks.clear();
+    attachments.clear();
+    attachmentStart.assign(1, 0);
+    int offset = 0;
+    for (int l = 0; l < static_cast<int>(lines.size()); ++l) {
+        const Line *line = lines[l];
+        const int begin[2] = {static_cast<int>(colours[0].size()), static_cast<int>(colours[1].size())};
+        for (int s = 0; s + 1 < line->size(); ++s) {
+            int a = line->first + s;
+            colours[s & 1].push_back({a, a + 1, line->delta, line->compliance});
+        }
+        for (int c = 0; c < 2; ++c) {
+            const int end = static_cast<int>(colours[c].size());
+            for (int b = begin[c]; b < end; b += BLOCK_CONSTRAINTS) {
+                blocks[c].push_back({l, b, std::min(end, b + BLOCK_CONSTRAINTS), 0.0f, 0.0f});
+            }
+            lineConstraints[l] += end - begin[c];
+        }
+        for (int s = 0; s + 1 < line->size(); s += BLOCK_CONSTRAINTS) {
+            chainBlocks.push_back({l, s, std::min(line->size() - 1, s + BLOCK_CONSTRAINTS), 0.0f, 0.0f});
+        }
+        chains.push_back({line->first, line->size(), offset, line->delta, line->compliance});
+        offset += std::max(0, line->size() - 1);
+
+        // Nearest pinned node before and after each free node.
+        const ParticleStore &p = *line->store;
+        int anchor = -1;
+        for (int s = 0; s < line->size(); ++s) {
+            const int i = line->first + s;
+            if (p.isFixed(i)) anchor = i;
+            else if (anchor >= 0) attachments.push_back({i, anchor, (i - anchor) * line->delta});
+        }
+        anchor = -1;
+        for (int s = line->size() - 1; s >= 0; --s) {
+            const int i = line->first + s;
+            if (p.isFixed(i)) anchor = i;
+            else if (anchor >= 0) attachments.push_back({i, anchor, (anchor - i) * line->delta});
+        }
+        attachmentStart.push_back(static_cast<int>(attachments.size()));
+    }
+}
+
+void ConstraintSolver::relax(ParticleStore &p, const std::vector<DistanceConstraint> &batch, Block &block) {
+    float maxStretch = 0.0f;
+    float sumSq = 0.0f;
+    for (int k = block.begin; k < block.end; ++k) {
+        const DistanceConstraint &c = batch[k];
+        float stretch = enforceMaxDistance(p, c.a, c.b, c.rest);
+        maxStretch = std::max(maxStretch, stretch);
+        sumSq += stretch * stretch;
+    }
+    block.maxStretch = maxStretch;
+    block.sumSqStretch = sumSq;
+}
+
+void ConstraintSolver::relaxXPBD(ParticleStore &p, const std::vector<DistanceConstraint> &batch,
+                                 std::vector<float> &lambda, float invHSq, Block &block) {
+    float maxStretch = 0.0f;
+    float sumSq = 0.0f;
+    for (int k = block.begin; k < block.end; ++k) {
+        const DistanceConstraint &c = batch[k];
+        float stretch = enforceDistanceXPBD(p, c.a, c.b, c.rest, c.compliance * invHSq, lambda[k]);
+        maxStretch = std::max(maxStretch, stretch);
+        sumSq += stretch * stretch;
+    }
+    block.maxStretch = maxStretch;
+    block.sumSqStretch = sumSq;
+}
+
+void ConstraintSolver::attach(ParticleStore &p, const Attachment *begin, const Attachment *end) {
+    for (const Attachment *a = begin; a != end; ++a) {
+        float dx = p.x[a->node] - p.x[a->anchor];
+        float dy = p.y[a->node] - p.y[a->anchor];
+        float distSq = dx * dx + dy * dy;
+        if (distSq <= a->maxDist * a->maxDist) continue;
+        float scale = a->maxDist / std::sqrt(distSq);
+        p.x[a->node] = p.x[a->anchor] + dx * scale;
+        p.y[a->node] = p.y[a->anchor] + dy * scale;
+    }
+}
+
+// Correction for both ends of every segment in the block, from positions
+// nobody writes until jacobiApply.
+void ConstraintSolver::jacobiGather(const ParticleStore &p, ChainBlock &block) {
+    const Chain &chain = chains[block.chain];
+    float maxStretch = 0.0f;
+    float sumSq = 0.0f;
+    for (int s = block.begin; s < block.end; ++s) {
+        const int a = chain.first + s;
+        const int b = a + 1;
+        const int k = chain.offset + s;
+        deltaAX[k] = deltaAY[k] = deltaBX[k] = deltaBY[k] = 0.0f;
+
+        const float w = p.invMass[a] + p.invMass[b];
+        float dx = p.x[b] - p.x[a];
+        float dy = p.y[b] - p.y[a];
+        float dist = std::sqrt(dx * dx + dy * dy);
+        if (w <= 0.0f || dist < 1e-6f) continue;
+
+        const float c = dist - chain.rest;
+        const float stretch = chain.rest > 0.0f ? std::fabs(c) / chain.rest : 0.0f;
+        maxStretch = std::max(maxStretch, stretch);
+        sumSq += stretch * stretch;
+
+        const float scale = c / (dist * w);
+        deltaAX[k] = p.invMass[a] * scale * dx;
+        deltaAY[k] = p.invMass[a] * scale * dy;
+        deltaBX[k] = -p.invMass[b] * scale * dx;
+        deltaBY[k] = -p.invMass[b] * scale * dy;
+    }
+    block.maxStretch = maxStretch;
+    block.sumSqStretch = sumSq;
+}
+
+// Node s of the chain takes segment s - 1's correction for its b end and
+// segment s's for its a end, always in that order.
+void ConstraintSolver::jacobiApply(ParticleStore &p, const ChainBlock &block, float relaxation) {
+    const Chain &chain = chains[block.chain];
+    const int m = chain.count - 1;
+    const int last = block.end == m ? m : block.end - 1;  // the chain's tail goes with its last block
+    for (int s = block.begin; s <= last; ++s) {
+        const int i = chain.first + s;
+        if (p.invMass[i] <= 0.0f) continue;
+        float sumX = 0.0f, sumY = 0.0f;
+        int count = 0;
+        if (s > 0) {
+            sumX += deltaBX[chain.offset + s - 1];
+            sumY += deltaBY[chain.offset + s - 1];
+            count++;
+        }
+        if (s < m) {
+            sumX += deltaAX[chain.offset + s];
+            sumY += deltaAY[chain.offset + s];
+            count++;
+        }
+        if (count == 0) continue;
+        const float scale = relaxation / count;
+        p.x[i] += sumX * scale;
+        p.y[i] += sumY * scale;
+    }
+}
+
+void ConstraintSolver::solveChain(ParticleStore &p, int c, float invHSq, float &maxStretch, float &sumSqStretch) {
+    const Chain &chain = chains[c];
+    const int m = chain.count - 1;  // constraints
+    double *nx = chainNx.data() + chain.offset;
+    double *ny = chainNy.data() + chain.offset;
+    double *diag = chainDiag.data() + chain.offset;
+    double *upper = chainUpper.data() + chain.offset;
+    double *rhs = chainRhs.data() + chain.offset;
+    double *lambda = chainLambda.data() + chain.offset;
+    const float *w = p.invMass.data() + chain.first;
+    float *x = p.x.data() + chain.first;
+    float *y = p.y.data() + chain.first;
+    const double alphaTilde = static_cast<double>(chain.compliance) * invHSq;
+
+    maxStretch = 0.0f;
+    sumSqStretch = 0.0f;
+
+    // Assemble. Row i is segment (i, i + 1); rows sharing node i + 1 couple
+    // through -w[i + 1] * dot(n_i, n_i+1). A segment between two fixed
+    // nodes gets an identity row so it is left alone.
+    for (int i = 0; i < m; ++i) {
+        double dx = x[i + 1] - x[i];
+        double dy = y[i + 1] - y[i];
+        double dist = std::sqrt(dx * dx + dy * dy);
+        if (dist < 1e-6) {
+            nx[i] = 0.0;
+            ny[i] = 0.0;
+        } else {
+            nx[i] = dx / dist;
+            ny[i] = dy / dist;
+        }
+        const double residual = dist - chain.rest + alphaTilde * lambda[i];
+        const double wSum = w[i] + w[i + 1];
+        if (wSum <= 0.0 || dist < 1e-6) {
+            diag[i] = 1.0;
+            rhs[i] = 0.0;
+        } else {
+            diag[i] = wSum + alphaTilde;
+            rhs[i] = -residual;
+            const float stretch = chain.rest > 0.0f ? static_cast<float>(std::fabs(residual) / chain.rest) : 0.0f;
+            maxStretch = std::max(maxStretch, stretch);
+            sumSqStretch += stretch * stretch;
+        }
+    }
+    for (int i = 0; i + 1 < m; ++i) {
+        upper[i] = -w[i + 1] * (nx[i] * nx[i + 1] + ny[i] * ny[i + 1]);
+    }
+
+    // Thomas algorithm; the system is symmetric positive definite, so no
+    // pivoting. The eliminated super-diagonal goes into diag (its original
+    // is no longer needed), the eliminated right-hand side into rhs, and
+    // back substitution leaves dlambda in rhs.
+    for (int i = 0; i < m; ++i) {
+        const double sub = i > 0 ? upper[i - 1] : 0.0;
+        const double denom = diag[i] - (i > 0 ? sub * diag[i - 1] : 0.0);
+        const double inv = denom != 0.0 ? 1.0 / denom : 0.0;
+        rhs[i] = (rhs[i] - (i > 0 ? sub * rhs[i - 1] : 0.0)) * inv;
+        diag[i] = i + 1 < m ? upper[i] * inv : 0.0;
+    }
+    for (int i = m - 2; i >= 0; --i) {
+        rhs[i] -= diag[i] * rhs[i + 1];
+    }
+
+    // dx_k = w_k * (n_(k-1) * dlambda_(k-1) - n_k * dlambda_k)
+    for (int k = 0; k <= m; ++k) {
+        double cx = 0.0, cy = 0.0;
+        if (k < m) {
+            cx -= nx[k] * rhs[k];
+            cy -= ny[k] * rhs[k];
+        }
+        if (k > 0) {
+            cx += nx[k - 1] * rhs[k - 1];
+            cy += ny[k - 1] * rhs[k - 1];
+        }
+        x[k] += static_cast<float>(w[k] * cx);
+        y[k] += static_cast<float>(w[k] * cy);
+    }
+    for (int i = 0; i < m; ++i) lambda[i] += rhs[i];
+}
+
+// Runs fn(begin, end) over [0, count) on the job system if there is one
+// and `parallel` is set, on the calling thread otherwise. Ranges are kept
+// small so stealing can even out lines or blocks of very different cost.
+static void forRanges(JobSystem *jobs, bool parallel, int count, const std::function<void(int, int)> &fn) {
+    if (jobs && parallel) jobs->parallelFor(count, std::max(1, count / (jobs->threadCount() * 8)), fn);
+    else fn(0, count);
+}
+
+void ConstraintSolver::solve(ParticleStore &p, const SolverSettings &settings) {
+    SolverStats stats;
+    const int lineCount = static_cast<int>(lineConstraints.size());
+    // Attachments clamp to rest length, which would cancel a soft line's
+    // compliance in the modes that honour it.
+    const bool compliant = settings.mode == SOLVER_XPBD || settings.mode == SOLVER_DIRECT;
+    auto attached = [&](int l) {
+        return settings.attachments && !(compliant && chains[l].compliance > 0.0f);
+    };
+    for (int l = 0; l < lineCount; ++l) {
+        if (attached(l)) stats.attachments += attachmentStart[l + 1] - attachmentStart[l];
+    }
+    const bool adaptive = settings.maxStretchTolerance > 0.0f || settings.rmsStretchTolerance > 0.0f;
+
+    lineActive.assign(lineCount, 0);
+    long long activeConstraints = 0;
+    for (int l = 0; l < lineCount; ++l) {
+        if (lineConstraints[l] == 0) continue;
+        lineActive[l] = 1;
+        activeConstraints += lineConstraints[l];
+        stats.lines++;
+    }
+
+    lineMax.assign(lineCount, 0.0f);
+    lineSumSq.assign(lineCount, 0.0f);
+
+    const bool xpbd = settings.mode == SOLVER_XPBD;
+    const float invHSq = settings.timeStep > 0.0f ? 1.0f / (settings.timeStep * settings.timeStep) : 0.0f;
+    if (xpbd) {
+        for (int c = 0; c < 2; ++c) lambdas[c].assign(colours[c].size(), 0.0f);
+    }
+    const bool direct = settings.mode == SOLVER_DIRECT;
+    const bool jacobi = settings.mode == SOLVER_JACOBI;
+    if (jacobi) {
+        const size_t n = colours[0].size() + colours[1].size();
+        for (std::vector<float> *buffer : {&deltaAX, &deltaAY, &deltaBX, &deltaBY}) buffer->resize(n);
+    }
+    if (direct) {
+        const size_t n = colours[0].size() + colours[1].size();
+        for (std::vector<double> *scratch : {&chainNx, &chainNy, &chainDiag, &chainUpper, &chainRhs}) {
+            scratch->resize(n);
+        }
+        chainLambda.assign(n, 0.0);
+    }
+
+    for (int it = 0; it < settings.maxIterations && activeConstraints > 0; ++it) {
+        if (settings.budget > 0 && stats.projections + activeConstraints > settings.budget) {
+            stats.budgetExhausted = true;
+            break;
+        }
+
+        const bool parallel = activeConstraints >= PARALLEL_MIN_CONSTRAINTS;
+        if (stats.attachments > 0) {
+            forRanges(settings.jobs, parallel, lineCount, [&](int begin, int end) {
+                for (int l = begin; l < end; ++l) {
+                    if (!lineActive[l] || !attached(l)) continue;
+                    attach(p, attachments.data() + attachmentStart[l], attachments.data() + attachmentStart[l + 1]);
+                }
+            });
+        }
+
+        if (direct) {
+            forRanges(settings.jobs, parallel, lineCount, [&](int begin, int end) {
+                for (int l = begin; l < end; ++l) {
+                    if (lineActive[l]) solveChain(p, l, invHSq, lineMax[l], lineSumSq[l]);
+                }
+            });
+        } else if (jacobi) {
+            const int n = static_cast<int>(chainBlocks.size());
+            forRanges(settings.jobs, parallel, n, [&](int begin, int end) {
+                for (int b = begin; b < end; ++b) {
+                    if (lineActive[chainBlocks[b].chain]) jacobiGather(p, chainBlocks[b]);
+                }
+            });
+            forRanges(settings.jobs, parallel, n, [&](int begin, int end) {
+                for (int b = begin; b < end; ++b) {
+                    if (lineActive[chainBlocks[b].chain]) jacobiApply(p, chainBlocks[b], settings.relaxation);
+                }
+            });
+
+            // Block order is fixed, so the per-line sums are too.
+            for (int l = 0; l < lineCount; ++l) {
+                if (!lineActive[l]) continue;
+                lineMax[l] = 0.0f;
+                lineSumSq[l] = 0.0f;
+            }
+            for (const ChainBlock &block : chainBlocks) {
+                if (!lineActive[block.chain]) continue;
+                lineMax[block.chain] = std::max(lineMax[block.chain], block.maxStretch);
+                lineSumSq[block.chain] += block.sumSqStretch;
+            }
+        } else {
+            for (int c = 0; c < 2; ++c) {
+                std::vector<Block> &batch = blocks[c];
+                forRanges(settings.jobs, parallel, static_cast<int>(batch.size()), [&](int begin, int end) {
+                    for (int b = begin; b < end; ++b) {
+                        if (!lineActive[batch[b].line]) continue;
+                        if (xpbd) relaxXPBD(p, colours[c], lambdas[c], invHSq, batch[b]);
+                        else relax(p, colours[c], batch[b]);
+                    }
+                });
+            }
+
+            for (int l = 0; l < lineCount; ++l) {
+                if (!lineActive[l]) continue;
+                lineMax[l] = 0.0f;
+                lineSumSq[l] = 0.0f;
+            }
+            for (const std::vector<Block> &batch : blocks) {
+                for (const Block &block : batch) {
+                    if (!lineActive[block.line]) continue;
+                    lineMax[block.line] = std::max(lineMax[block.line], block.maxStretch);
+                    lineSumSq[block.line] += block.sumSqStretch;
+                }
+            }
+        }
+
+        stats.sweeps = it + 1;
+        stats.projections += activeConstraints;
+        for (int l = 0; l < lineCount; ++l) {
+            if (!lineActive[l]) continue;
+            stats.lineSweeps++;
+            if (!adaptive) continue;
+            const float rms = std::sqrt(lineSumSq[l] / lineConstraints[l]);
+            if (lineMax[l] <= settings.maxStretchTolerance || settings.maxStretchTolerance <= 0.0f) {
+                if (rms <= settings.rmsStretchTolerance || settings.rmsStretchTolerance <= 0.0f) {
+                    lineActive[l] = 0;
+                    activeConstraints -= lineConstraints[l];
+                    stats.convergedLines++;
+                }
+            }
+        }
+    }
+
+    double sumSq = 0.0;
+    long long constraints = 0;
+    for (int l = 0; l < lineCount; ++l) {
+        stats.maxStretch = std::max(stats.maxStretch, lineMax[l]);
+        sumSq += lineSumSq[l];
+        constraints += lineConstraints[l];
+    }
+    stats.rmsStretch = constraints > 0 ? static_cast<float>(std::sqrt(sumSq / constraints)) : 0.0f;
+    lastStats = stats;
+}
+
+void ConstraintSolver::solve(ParticleStore &p, int iterations) {
+    SolverSettings settings;
+    settings.maxIterations = iterations;
+    solve(p, settings);
+}
+
+int ConstraintSolver::constraintCount() const {
+    return static_cast<int>(colours[0].size() + colours[1].size());
+}
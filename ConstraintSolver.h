@@ -0,0 +1,177 @@
+#ifndef CONSTRAINTSOLVER_H
+#define CONSTRAINTSOLVER_H
+#include <vector>
+
+#include "JobSystem.h"
+#include "Line.h"
+
+struct DistanceConstraint {
+  int a;
+  int b;
+  float rest;
+  float compliance;  // XPBD only
+};
+
+// Long-range attachment: a free node may be no further from a pinned node
+// of its line than the rest length of the chain between them. Under the
+// modes that honour compliance (SOLVER_XPBD, SOLVER_DIRECT) a line with
+// compliance > 0 skips its attachments, since a soft rope is meant to
+// stretch past rest length.
+struct Attachment {
+  int node;
+  int anchor;
+  float maxDist;
+};
+
+enum SolverMode {
+  // Position-based projection; stiffness depends on iterations and h.
+  SOLVER_PBD,
+  // Extended PBD: compliance and accumulated Lagrange multipliers make
+  // stiffness independent of iteration count and timestep.
+  SOLVER_XPBD,
+  // Each line's linearised chain system J W J^T dlambda = -C (plus XPBD
+  // compliance) is tridiagonal; one Thomas-algorithm pass per sweep solves
+  // it exactly in O(n), so a long rope converges in a sweep or two
+  // instead of moving corrections one segment per sweep.
+  SOLVER_DIRECT,
+  // Every constraint of a sweep is computed from the same positions into
+  // per-constraint buffers, then each node applies the average of its
+  // corrections times the over-relaxation factor. Corrections are summed
+  // in a fixed order, so the result is bit-identical for any thread count.
+  SOLVER_JACOBI,
+  SOLVER_MODE_COUNT
+};
+
+// Lower-case name for command lines and the UI ("pbd", "xpbd", "direct",
+// "jacobi").
+const char *solverModeName(SolverMode mode);
+
+// How hard solve() tries. Each line is swept until its relative stretch
+// |dist - rest| / rest is under both tolerances or it hits maxIterations;
+// tolerances of 0 always run the cap. Under XPBD the stretch is the
+// compliance-adjusted residual |C + compliance / h^2 * lambda| / rest, so a
+// soft rope converges at its natural extension.
+struct SolverSettings {
+  SolverMode mode = SOLVER_PBD;
+  float timeStep = 0.1f;  // substep length, for XPBD's compliance / h^2
+  int maxIterations = 8;
+  // SOLVER_JACOBI over-relaxation of the averaged corrections.
+  float relaxation = 1.5f;
+  // Project long-range attachments at the start of every sweep.
+  bool attachments = false;
+  float maxStretchTolerance = 0.0f;
+  float rmsStretchTolerance = 0.0f;
+  // Upper bound on constraint projections per solve() across all lines;
+  // sweeping stops once the next one would exceed it. 0 is unlimited.
+  long long budget = 0;
+  // Optional worker pool for the colour blocks, chains and attachments;
+  // every sweep runs on the calling thread when null.
+  JobSystem *jobs = nullptr;
+};
+
+// What the last solve() did. Stretch is measured while sweeping, before
+// each constraint is corrected, and taken from each line's final sweep.
+struct SolverStats {
+  int lines = 0;                // lines with at least one constraint
+  int sweeps = 0;               // most sweeps any line took
+  long long lineSweeps = 0;     // sweeps summed over lines
+  long long projections = 0;    // constraints projected
+  int convergedLines = 0;       // stopped under tolerance
+  int attachments = 0;          // long-range attachments in use
+  bool budgetExhausted = false;
+  float maxStretch = 0.0f;
+  float rmsStretch = 0.0f;
+};
+
+// Graph-coloured Gauss-Seidel over the rope segments of every line.
+// Segment i joins nodes i and i + 1, so all even segments share no node
+// with each other (likewise the odd ones) and each colour can be relaxed
+// in parallel (on the settings' job system) without races. Lines never
+// share nodes, so one batch per colour covers every rope in the scene. The batches only need rebuilding
+// when the topology changes.
+//
+// Each colour is cut into blocks that never span two lines, so a line
+// that has converged drops out of later sweeps while the others go on.
+// SOLVER_DIRECT ignores the colouring and solves each line as one chain,
+// lines in parallel.
+//
+// build() also ties every free node to the nearest pinned node on each
+// side of it along the line. Those unilateral constraints reach the whole
+// rope in one pass, so a hanging rope can't sag past its rest length while
+// the distance constraints are still passing corrections along it. Which
+// nodes are pinned is read at build time; rebuild after toggling one.
+// Lines with compliance > 0 leave their attachments out under XPBD and
+// DIRECT, where the clamp to rest length would undo the compliance.
+class ConstraintSolver {
+public:
+  void build(const std::vector<Line*> &lines);
+  void solve(ParticleStore &p, const SolverSettings &settings);
+  // Fixed number of sweeps over every line.
+  void solve(ParticleStore &p, int iterations);
+
+  int constraintCount() const;
+  int attachmentCount() const { return static_cast<int>(attachments.size()); }
+  const SolverStats &stats() const { return lastStats; }
+
+private:
+  struct Block {
+    int line;   // into lineConstraints / lineActive
+    int begin;  // into the colour's constraints
+    int end;
+    // Written by the thread relaxing the block, summed per line after.
+    float maxStretch;
+    float sumSqStretch;
+  };
+
+  std::vector<DistanceConstraint> colours[2];
+  std::vector<float> lambdas[2];  // per constraint, reset every solve()
+  std::vector<Block> blocks[2];
+
+  struct Chain {
+    int first;   // particle index of the root
+    int count;   // nodes
+    int offset;  // first constraint in the scratch arrays below
+    float rest;
+    float compliance;
+  };
+  std::vector<Chain> chains;  // per line
+  // Line l's attachments are [attachmentStart[l], attachmentStart[l + 1]).
+  std::vector<Attachment> attachments;
+  std::vector<int> attachmentStart;
+  // Per-constraint scratch for SOLVER_DIRECT, each chain owning
+  // [offset, offset + count - 1): segment directions, the tridiagonal
+  // system (sub-diagonal is the super-diagonal shifted by one) and the
+  // accumulated multipliers. Double precision: the system's condition
+  // number grows with the square of the chain length.
+  std::vector<double> chainNx, chainNy, chainDiag, chainUpper, chainRhs, chainLambda;
+
+  // SOLVER_JACOBI: runs of at most BLOCK_CONSTRAINTS segments of one
+  // chain, and the correction each segment wants for its two ends.
+  struct ChainBlock {
+    int chain;
+    int begin;  // segment range within the chain
+    int end;
+    float maxStretch;
+    float sumSqStretch;
+  };
+  std::vector<ChainBlock> chainBlocks;
+  std::vector<float> deltaAX, deltaAY, deltaBX, deltaBY;
+  std::vector<int> lineConstraints;     // per line
+  std::vector<unsigned char> lineActive;
+  // Each line's residual from the last sweep it took part in.
+  std::vector<float> lineMax;
+  std::vector<float> lineSumSq;
+  SolverStats lastStats;
+
+  static void relax(ParticleStore &p, const std::vector<DistanceConstraint> &batch, Block &block);
+  static void relaxXPBD(ParticleStore &p, const std::vector<DistanceConstraint> &batch,
+                        std::vector<float> &lambda, float invHSq, Block &block);
+  static void attach(ParticleStore &p, const Attachment *begin, const Attachment *end);
+  void jacobiGather(const ParticleStore &p, ChainBlock &block);
+  void jacobiApply(ParticleStore &p, const ChainBlock &block, float relaxation);
+  // One direct pass over chain c; returns max and sum of squared residual.
+  void solveChain(ParticleStore &p, int c, float invHSq, float &maxStretch, float &sumSqStretch);
+};
+
+
+#endif //CONSTRAINTSOLVER_H
@@ -0,0 +1,27 @@
+#include "FixedTimestep.h"
+#include <cmath>
+
+int FixedTimestep::consume(double frameSeconds) {
+    if (substeps < 1) substeps = 1;
+    if (frameSeconds > 0.0) accumulator += frameSeconds;
+
+    const double h = substepSeconds();
+    int steps = static_cast<int>(std::floor(accumulator / h));
+    accumulator -= steps * h;
+
+    if (steps > maxStepsPerFrame) {
+        dropped += steps - maxStepsPerFrame;
+        steps = maxStepsPerFrame;
+    }
+    last = steps;
+    return steps;
+}
+
+void FixedTimestep::reset() {
+    accumulator = 0.0;
+    last = 0;
+}
+
+float FixedTimestep::alpha() const {
+    return static_cast<float>(accumulator / substepSeconds());
+}
@@ -0,0 +1,33 @@
+#ifndef FIXEDTIMESTEP_H
+#define FIXEDTIMESTEP_H
+
+// Accumulator that turns wall-clock frame time into a whole number of
+// fixed physics substeps. One full step (SimulationParams::timeStep of
+// simulated time) corresponds to `stepSeconds` of real time and is split
+// into `substeps` equal substeps.
+class FixedTimestep {
+public:
+  double stepSeconds = 1.0 / 60.0;
+  int substeps = 1;
+  int maxStepsPerFrame = 16;  // catch-up clamp, in substeps
+
+  // Adds frame time and returns how many substeps to run now. Steps beyond
+  // the clamp are dropped so a stalled frame can't trigger a spiral of death.
+  int consume(double frameSeconds);
+  void reset();
+
+  double substepSeconds() const { return stepSeconds / substeps; }
+  // Fraction of a substep left in the accumulator, for render interpolation.
+  float alpha() const;
+
+  long long droppedSteps() const { return dropped; }
+  int lastSteps() const { return last; }
+
+private:
+  double accumulator = 0.0;
+  long long dropped = 0;
+  int last = 0;
+};
+
+
+#endif //FIXEDTIMESTEP_H
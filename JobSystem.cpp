@@ -0,0 +1,149 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+long long nanosSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+}
+
+JobSystem::JobSystem(int threads) {
+    if (threads <= 0) threads = static_cast<int>(std::thread::hardware_concurrency());
+    threads = std::max(1, threads);
+
+    for (int w = 0; w < threads; ++w) queues.push_back(std::make_unique<Queue>());
+    counters = std::make_unique<Counters[]>(threads);
+    for (int w = 1; w < threads; ++w) workers.emplace_back(&JobSystem::workerLoop, this, w);
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) worker.join();
+}
+
+void JobSystem::parallelFor(int count, int grain, const std::function<void(int, int)> &fn) {
+    if (count <= 0) return;
+    grain = std::max(1, grain);
+    const int rangeCount = (count + grain - 1) / grain;
+    const auto start = std::chrono::steady_clock::now();
+    job = &fn;
+    pending.store(rangeCount, std::memory_order_relaxed);
+
+    // Nothing to share: skip the queues entirely.
+    if (rangeCount == 1 || workers.empty()) {
+        for (int begin = 0; begin < count; begin += grain) run(0, {begin, std::min(count, begin + grain)}, false);
+        job = nullptr;
+        parallelNanos.fetch_add(nanosSince(start), std::memory_order_relaxed);
+        return;
+    }
+
+    // Contiguous blocks keep neighbouring ranges on one worker; stealing
+    // evens out whatever the split gets wrong.
+    const int threads = threadCount();
+    for (int w = 0; w < threads; ++w) {
+        const int first = static_cast<int>(static_cast<long long>(rangeCount) * w / threads);
+        const int last = static_cast<int>(static_cast<long long>(rangeCount) * (w + 1) / threads);
+        std::lock_guard<std::mutex> lock(queues[w]->mutex);
+        for (int r = first; r < last; ++r) {
+            queues[w]->ranges.push_back({r * grain, std::min(count, (r + 1) * grain)});
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        generation++;
+    }
+    wake.notify_all();
+
+    drain(0);
+    while (pending.load(std::memory_order_acquire) > 0) std::this_thread::yield();
+    job = nullptr;
+    parallelNanos.fetch_add(nanosSince(start), std::memory_order_relaxed);
+}
+
+void JobSystem::workerLoop(int worker) {
+    unsigned long long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait(lock, [&] { return quit || generation != seen; });
+            if (quit) return;
+            seen = generation;
+        }
+        drain(worker);
+    }
+}
+
+void JobSystem::drain(int worker) {
+    Range range;
+    while (true) {
+        if (popOwn(worker, range)) run(worker, range, false);
+        else if (steal(worker, range)) run(worker, range, true);
+        else return;
+    }
+}
+
+bool JobSystem::popOwn(int worker, Range &range) {
+    Queue &queue = *queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.ranges.empty()) return false;
+    range = queue.ranges.back();
+    queue.ranges.pop_back();
+    return true;
+}
+
+bool JobSystem::steal(int worker, Range &range) {
+    const int threads = threadCount();
+    for (int k = 1; k < threads; ++k) {
+        Queue &victim = *queues[(worker + k) % threads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.ranges.empty()) continue;
+        range = victim.ranges.front();
+        victim.ranges.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::run(int worker, const Range &range, bool stolen) {
+    const auto start = std::chrono::steady_clock::now();
+    Counters &c = counters[worker];
+    c.jobs.fetch_add(1, std::memory_order_relaxed);
+    if (stolen) c.steals.fetch_add(1, std::memory_order_relaxed);
+    (*job)(range.begin, range.end);
+    c.busyNanos.fetch_add(nanosSince(start), std::memory_order_relaxed);
+    pending.fetch_sub(1, std::memory_order_release);
+}
+
+std::vector<WorkerStats> JobSystem::stats() const {
+    std::vector<WorkerStats> out(threadCount());
+    for (int w = 0; w < threadCount(); ++w) {
+        out[w].jobs = counters[w].jobs.load(std::memory_order_relaxed);
+        out[w].steals = counters[w].steals.load(std::memory_order_relaxed);
+        out[w].busySeconds = counters[w].busyNanos.load(std::memory_order_relaxed) * 1e-9;
+    }
+    return out;
+}
+
+double JobSystem::parallelSeconds() const {
+    return parallelNanos.load(std::memory_order_relaxed) * 1e-9;
+}
+
+double JobSystem::utilisation(int worker) const {
+    const double total = parallelSeconds();
+    if (total <= 0.0 || worker < 0 || worker >= threadCount()) return 0.0;
+    return counters[worker].busyNanos.load(std::memory_order_relaxed) * 1e-9 / total;
+}
+
+void JobSystem::resetStats() {
+    for (int w = 0; w < threadCount(); ++w) {
+        counters[w].jobs.store(0, std::memory_order_relaxed);
+        counters[w].steals.store(0, std::memory_order_relaxed);
+        counters[w].busyNanos.store(0, std::memory_order_relaxed);
+    }
+    parallelNanos.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,89 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct WorkerStats {
+  long long jobs = 0;      // ranges run by this worker
+  long long steals = 0;    // of which taken from another worker's queue
+  double busySeconds = 0.0;
+};
+
+// Small work-stealing thread pool. parallelFor() cuts [0, count) into
+// ranges and deals them out in contiguous blocks, one block per worker
+// queue; each worker pops its own queue from the back and, once that is
+// empty, steals from the front of the others, so a worker stuck on one
+// expensive range is relieved of the rest of its block. The calling thread
+// works as worker 0 and parallelFor() returns when every range is done.
+//
+// parallelFor() may only be called from one thread at a time and not from
+// inside a job.
+class JobSystem {
+public:
+  // threads counts the caller; 0 picks std::thread::hardware_concurrency().
+  explicit JobSystem(int threads = 0);
+  ~JobSystem();
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  int threadCount() const { return static_cast<int>(queues.size()); }
+
+  // Runs fn(begin, end) over [0, count) in ranges of at most grain items.
+  void parallelFor(int count, int grain, const std::function<void(int, int)> &fn);
+
+  // Per-worker counters since the last resetStats(); worker 0 is the caller.
+  std::vector<WorkerStats> stats() const;
+  // Wall time spent inside parallelFor() since the last resetStats().
+  double parallelSeconds() const;
+  // busySeconds / parallelSeconds for one worker; 1 means never idle.
+  double utilisation(int worker) const;
+  void resetStats();
+
+private:
+  struct Range {
+    int begin;
+    int end;
+  };
+
+  struct alignas(64) Queue {
+    std::mutex mutex;
+    std::deque<Range> ranges;
+  };
+
+  struct alignas(64) Counters {
+    std::atomic<long long> jobs{0};
+    std::atomic<long long> steals{0};
+    std::atomic<long long> busyNanos{0};
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::unique_ptr<Counters[]> counters;
+  std::vector<std::thread> workers;
+
+  const std::function<void(int, int)> *job = nullptr;
+  std::atomic<int> pending{0};  // ranges not yet finished
+  std::atomic<long long> parallelNanos{0};
+
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+  unsigned long long generation = 0;
+  bool quit = false;
+
+  void workerLoop(int worker);
+  // Runs ranges until none are left anywhere. Returns once all queues
+  // are empty, not when the last range has finished.
+  void drain(int worker);
+  bool popOwn(int worker, Range &range);
+  bool steal(int worker, Range &range);
+  void run(int worker, const Range &range, bool stolen);
+};
+
+
+#endif //JOBSYSTEM_H
@@ -3,237 +3,236 @@
 //
 
 #include "Line.h"
+#include <atomic>
 #include <iostream>
+#include <mutex>
 
-Node::Node(float *position, Node *previous)
-    : next(nullptr), prev(previous), fixed(false) {
-    this->position = new float[3];
-    std::memcpy(this->position, position, 3 * sizeof(float));
-    this->previousPos = new float[3];
-    std::memcpy(this->previousPos, position, 3 * sizeof(float));
+#include "ObjectPool.h"
 
-    for (int i = 0; i < 3;i++) {
-        this->previousPos[i] += 5;
-    }
-
-    this->color = new float[3]{1.0f, 1.0f, 1.0f}; // default white
+Node::Node()
+    : store(nullptr), index(-1) {
 }
 
-Node::~Node() {
-    delete[] position;
-    delete[] color;
-    delete[] previousPos;
+Node::Node(ParticleStore *store, int index)
+    : store(store), index(index) {
 }
 
-void Node::setNext(Node *next) {
-    this->next = next;
+void Node::setPosition(float px, float py) {
+    store->x[index] = px;
+    store->y[index] = py;
 }
 
-Node *Node::getNext() {
-    return next;
+bool Node::isFixed() const {
+    return store->isFixed(index);
 }
 
-void Node::setPrevious(Node *previous) {
-    this->prev = previous;
+void Node::setFixed(bool fixed) {
+    store->setFixed(index, fixed);
 }
 
-Node *Node::getPrevious() {
-    return prev;
+// Intentionally never destroyed: lines may be deleted during static
+// destruction (e.g. by a global Simulation) after a static pool would be gone.
+static ObjectPool<Line> &linePool() {
+    static ObjectPool<Line> *pool = new ObjectPool<Line>();
+    return *pool;
 }
 
-void Node::setPosition(float *pos) {
-    std::memcpy(this->position, pos, 3 * sizeof(float));
+// The pool is shared by every Simulation in the process, and lines are made
+// on whichever thread owns one (the main thread while building a scene, the
+// simulation thread once it runs), so every pool access takes this lock.
+static std::mutex &linePoolMutex() {
+    static std::mutex *mutex = new std::mutex();
+    return *mutex;
 }
 
-float *Node::getPosition() {
-    return position;
+void *Line::operator new(std::size_t size) {
+    if (size != sizeof(Line)) return ::operator new(size);
+    std::lock_guard<std::mutex> lock(linePoolMutex());
+    return linePool().allocate();
 }
 
-void Node::setColor(float *col) {
-    std::memcpy(this->color, col, 3 * sizeof(float));
+void Line::operator delete(void *ptr, std::size_t size) {
+    if (size != sizeof(Line)) {
+        ::operator delete(ptr);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(linePoolMutex());
+    linePool().deallocate(ptr);
 }
 
-float *Node::getColor() {
-    return color;
+PoolStats Line::poolStats() {
+    std::lock_guard<std::mutex> lock(linePoolMutex());
+    return linePool().stats();
 }
 
-void Node::setFixed(bool fixed) {
-    this->fixed = fixed;
+static uint32_t nextLineId() {
+    static std::atomic<uint32_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
 }
 
-Line::Line() {
-    end = nullptr;
-    root = nullptr;
-
+Line::Line(ParticleStore &store)
+    : store(&store), first(0), count(0), capacity(0), delta(0.0f), id(nextLineId()) {
 }
 
-Line::Line(int size, int numPoints, float *start) {
+Line::Line(ParticleStore &store, int size, int numPoints, float *start)
+    : store(&store), first(0), count(0), capacity(0), id(nextLineId()) {
     float dlt = static_cast<float>(size) / (numPoints - 1);
     initWithDelta(dlt, numPoints, start);
     this->delta = dlt;
 }
 
-Line::Line(float delta, int numPoints, float *start) {
+Line::Line(ParticleStore &store, float delta, int numPoints, float *start)
+    : store(&store), first(0), count(0), capacity(0), id(nextLineId()) {
     initWithDelta(delta, numPoints, start);
     this->delta = delta;
 }
 
 void Line::initWithDelta(float delta, int numPoints, float *start) {
-    float pos[3] = {start[0], start[1], start[2]};
-    root = new Node(pos, nullptr);
-    Node *current = root;
-
-    for (int i = 1; i < numPoints; ++i) {
-        pos[0] += delta; // move in +x
-        Node *next = new Node(pos, current);
-        current->setNext(next);
-        current = next;
+    if (numPoints <= 0) return;
+
+    first = store->allocate(numPoints);
+    count = numPoints;
+    capacity = numPoints;
+
+    float px = start[0];
+    for (int i = 0; i < numPoints; ++i) {
+        store->init(first + i, px, start[1]);
+        px += delta; // move in +x
     }
+}
 
-    end = current;
+Node Line::getNode(int idx) {
+    if (idx < 0 || idx >= count) return Node();
+    return Node(store, first + idx);
 }
 
-Node *Line::getNode(int idx) {
-    Node *current = root;
-    int i = 0;
-    while (current && i < idx) {
-        current = current->getNext();
-        i++;
-    }
-    return current;
+int Line::indexOf(int particle) const {
+    if (particle < first || particle >= first + count) return -1;
+    return particle - first;
 }
 
 Line::~Line() {
-    Node *current = root;
-    while (current) {
-        Node *next = current->getNext();
-        delete current;
-        current = next;
+    if (capacity > 0) {
+        store->release(first, capacity);
     }
 }
 
 void Line::PrintV() {
-    Node *current = root;
-    int idx = 0;
-
-    while (current) {
-        float *pos = current->getPosition();
+    for (int idx = 0; idx < count; ++idx) {
+        int i = first + idx;
         std::cout << "| " << idx << " | Pos: ("
-                  << pos[0] << ", " << pos[1] << ", " << pos[2] << ")"
-                  << (current->getNext() ? " -> " : " [END]") << "\n";
-        current = current->getNext();
-        ++idx;
+                  << store->x[i] << ", " << store->y[i] << ")"
+                  << (idx + 1 < count ? " -> " : " [END]") << "\n";
     }
 }
 
 
 
 void Line::Print() {
-    Node *current = root;
-    int idx = 1;
-
-    while (current) {
-        float *pos = current->getPosition();
-        std::cout << "| (" << idx << ")  Pos: "<<pos[0] << " |"<< (current->getNext() ? " -> " : " [END]");
-        current = current->getNext();
-        ++idx;
+    for (int idx = 0; idx < count; ++idx) {
+        std::cout << "| (" << idx + 1 << ")  Pos: " << store->x[first + idx] << " |"
+                  << (idx + 1 < count ? " -> " : " [END]");
     }
     std::cout << "\n";
 }
 
 
-void Line::newRoot(Node *newRoot) {
-    Node *currRoot = newRoot;
-    while (currRoot->getNext()) {
-        currRoot = currRoot->getNext();
-    }
-    root->setPrevious(currRoot);
-    currRoot->setNext(root);
-    root = newRoot;
-}
-
-void Line::newTail(Node *newTail) {
-    if (!newTail) return;  // nothing to append
-
-    if (!end) {
-        // If the current list is empty, newTail becomes root and end
-        root = newTail;
-
-        // Find the tail of newTail chain
-        Node *tail = newTail;
-        while (tail->getNext()) {
-            tail = tail->getNext();
+void Line::concat(Line *front, Line *back) {
+    int frontFirst = front->first, frontCount = front->count, frontCapacity = front->capacity;
+    int backFirst = back->first, backCount = back->count, backCapacity = back->capacity;
+    front->count = front->capacity = 0;
+    back->count = back->capacity = 0;
+
+    if (frontCount == 0 || backCount == 0) {
+        // One side is empty: keep the other's range and reservation.
+        if (frontCount == 0) {
+            store->release(frontFirst, frontCapacity);
+            first = backFirst;
+            count = backCount;
+            capacity = backCapacity;
+        } else {
+            store->release(backFirst, backCapacity);
+            first = frontFirst;
+            count = frontCount;
+            capacity = frontCapacity;
         }
-        end = tail;
         return;
     }
 
-
-    // Connect current end's next to newTail
-    end->setNext(newTail);
-    newTail->setPrevious(end);
-
-    // Update end pointer to newTail's tail
-    Node *tail = newTail;
-    while (tail->getNext()) {
-        tail = tail->getNext();
+    const int total = frontCount + backCount;
+    const int spare = frontCapacity - frontCount;
+    if (frontFirst + frontCapacity == backFirst && spare == 0) {
+        // Ranges already touch: just widen the window.
+        first = frontFirst;
+        capacity = frontCount + backCapacity;
+    } else if (spare >= backCount) {
+        // The front's reserved slack takes the back; the store is not asked.
+        store->copyRange(backFirst, backCount, frontFirst + frontCount);
+        store->release(backFirst, backCapacity);
+        first = frontFirst;
+        capacity = frontCapacity;
+    } else if (store->extendBack(frontFirst, frontCapacity, backCount - spare)) {
+        // Free space after the front: only the back half moves.
+        store->copyRange(backFirst, backCount, frontFirst + frontCount);
+        store->release(backFirst, backCapacity);
+        first = frontFirst;
+        capacity = total;
+    } else if (store->extendFront(backFirst, frontCount)) {
+        // Free space before the back: only the front half moves.
+        store->copyRange(frontFirst, frontCount, backFirst);
+        store->release(frontFirst, frontCapacity);
+        first = backFirst;
+        capacity = frontCount + backCapacity;
+    } else {
+        // Relocate both and keep geometric slack behind the result, reserved
+        // on this line so no other allocation can take it: a run of appends
+        // onto this line is amortised O(1) per node.
+        const int slack = total / 2;
+        const int dst = store->allocate(total + slack);
+        store->copyRange(frontFirst, frontCount, dst);
+        store->copyRange(backFirst, backCount, dst + frontCount);
+        store->release(frontFirst, frontCapacity);
+        store->release(backFirst, backCapacity);
+        first = dst;
+        capacity = total + slack;
     }
-    end = tail;
+    count = total;
 }
 
-std::pair<Line*, Line*> Line::split(int pos) {
-    if (pos <= 0) {
-        // Return empty first line and the whole line as second
-        Line* emptyLine = new Line();
-        Line* wholeLine = new Line();
-        wholeLine->root = this->root;
-        wholeLine->end = this->end;
-
-        // Clear this to avoid double delete
-        this->root = nullptr;
-        this->end = nullptr;
-
-        return {emptyLine, wholeLine};
-    }
-
-    Node* splitNode = getNode(pos);
-    if (!splitNode) {
-        // pos out of range, return whole line and empty line
-        Line* wholeLine = new Line();
-        wholeLine->root = this->root;
-        wholeLine->end = this->end;
-
-        Line* emptyLine = new Line();
-
-        this->root = nullptr;
-        this->end = nullptr;
-
-        return {wholeLine, emptyLine};
-    }
-
-    // Disconnect at splitNode
-    Node* prevNode = splitNode->getPrevious();
-    if (prevNode) {
-        prevNode->setNext(nullptr);
-    }
-    splitNode->setPrevious(nullptr);
+void Line::newRoot(Line *other) {
+    if (!other || other == this) return;
+    concat(other, this);
+}
 
-    // Build first Line (from root to prevNode)
-    Line* firstLine = new Line();
-    firstLine->root = this->root;
-    firstLine->end = prevNode;
+void Line::newTail(Line *other) {
+    if (!other || other == this) return;  // nothing to append
+    concat(this, other);
+}
 
-    // Build second Line (from splitNode to old end)
-    Line* secondLine = new Line();
-    secondLine->root = splitNode;
-    secondLine->end = this->end;
+std::pair<Line*, Line*> Line::split(int pos) {
+    if (pos < 0) pos = 0;
+    if (pos > count) pos = count;
+
+    // Both halves are just sub-ranges of this line's storage; reserved
+    // slack goes back to the store.
+    store->release(first + count, capacity - count);
+    Line* firstLine = new Line(*store);
+    firstLine->first = this->first;
+    firstLine->count = pos;
+    firstLine->capacity = pos;
+    firstLine->delta = this->delta;
+    firstLine->compliance = this->compliance;
+
+    Line* secondLine = new Line(*store);
+    secondLine->first = this->first + pos;
+    secondLine->count = this->count - pos;
+    secondLine->capacity = this->count - pos;
+    secondLine->delta = this->delta;
+    secondLine->compliance = this->compliance;
 
     // Clear this line to avoid double free
-    this->root = nullptr;
-    this->end = nullptr;
+    this->count = 0;
+    this->capacity = 0;
 
     return {firstLine, secondLine};
 }
-
-
-
@@ -4,60 +4,94 @@
 
 #ifndef LINE_H
 #define LINE_H
-#include <__utility/pair.h>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
 
+#include "ParticleStore.h"
+
+// Lightweight handle to a particle in a ParticleStore.
 class Node {
 public:
-  float *position;
-  float *previousPos;
-  float *color;
-  Node *next;
-  Node *prev;
-  bool fixed;
-
-  Node(float *position, Node *previous = nullptr);
-  ~Node();
+  ParticleStore *store;
+  int index;
 
-  void setNext(Node *next);
-  Node *getNext();
+  Node();
+  Node(ParticleStore *store, int index);
 
-  void setPrevious(Node *previous);
-  Node *getPrevious();
+  bool valid() const { return store != nullptr && index >= 0; }
 
-  void setPosition(float *position);
-  float *getPosition();
+  float &x() { return store->x[index]; }
+  float &y() { return store->y[index]; }
+  float &prevX() { return store->prevX[index]; }
+  float &prevY() { return store->prevY[index]; }
 
-  void setColor(float *color);
-  float *getColor();
+  void setPosition(float x, float y);
 
+  bool isFixed() const;
   void setFixed(bool fixed);
+
+  bool operator==(const Node &other) const {
+    return store == other.store && index == other.index;
+  }
+  bool operator!=(const Node &other) const { return !(*this == other); }
 };
 
 
+// A rope: the contiguous particle range [first, first + count) of a store.
+// The line owns [first, first + capacity); the nodes past count are slack
+// left by a relocating join, reserved so later appends land in place.
+// Line objects come from a slab pool, so new/delete (split, insert, cut,
+// delete) never reach the general heap once the pool is warm. The pool is
+// process-wide and locked, so lines may be made and freed on any thread.
 class Line {
 public:
-  Node *root;
-  Node *end;
+  ParticleStore *store;
+  int first;
+  int count;
+  int capacity;  // >= count; released with the line or on split
   float delta;
-  Line();
-
-  Line(int size, int numPoints, float *start);
-  Line(float delta, int numPoints, float *start);
+  // XPBD compliance (inverse stiffness) of every segment; 0 is rigid.
+  float compliance = 0.0f;
+  // Unique for the life of the process, unlike the pooled address, so a
+  // line can be named safely from another thread.
+  uint32_t id;
+  // Sleep state, managed by Simulation: consecutive steps spent below the
+  // rest threshold, and whether the line is currently skipped.
+  int restSteps = 0;
+  bool asleep = false;
+  explicit Line(ParticleStore &store);
+
+  Line(ParticleStore &store, int size, int numPoints, float *start);
+  Line(ParticleStore &store, float delta, int numPoints, float *start);
   ~Line();
 
-  Node *getNode(int idx);
+  static void *operator new(std::size_t size);
+  static void operator delete(void *ptr, std::size_t size);
+  // Copy taken under the pool lock.
+  static PoolStats poolStats();
+
+  int size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  Node getNode(int idx);
+  Node root() { return getNode(0); }
+  Node tail() { return getNode(count - 1); }
+  // Position of a store index inside this line, or -1 if it belongs elsewhere.
+  int indexOf(int particle) const;
 
   void PrintV();
   void Print();
 
-  void newRoot(Node *root);
-
-  void newTail(Node *newTail);
+  // Prepend / append the nodes of another line, leaving `other` empty.
+  void newRoot(Line *other);
+  void newTail(Line *other);
 
   std::pair<Line*, Line*> split(int pos);
 
 private:
   void initWithDelta(float delta, int numPoints, float *start);
+  void concat(Line *front, Line *back);
 };
 
 
@@ -0,0 +1,69 @@
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+#include <cstddef>
+#include <new>
+#include <vector>
+
+struct PoolStats {
+  long long live = 0;       // objects (or particles) currently handed out
+  long long capacity = 0;   // slots backed by memory
+  long long highWater = 0;  // peak of `live`
+};
+
+// Fixed-size slab allocator: memory comes in slabs of SlabSize slots and
+// freed slots go on an intrusive free list, so allocate/deallocate are O(1)
+// and only touch the heap when a new slab is needed. Not thread-safe: a
+// pool shared between threads needs an external lock.
+template <typename T, int SlabSize = 256>
+class ObjectPool {
+public:
+  ObjectPool() = default;
+  ObjectPool(const ObjectPool &) = delete;
+  ObjectPool &operator=(const ObjectPool &) = delete;
+
+  ~ObjectPool() {
+    for (Slot *slab : slabs) ::operator delete(slab);
+  }
+
+  void *allocate() {
+    if (!freeList) grow();
+    Slot *slot = freeList;
+    freeList = slot->next;
+    counts.live++;
+    if (counts.live > counts.highWater) counts.highWater = counts.live;
+    return slot->storage;
+  }
+
+  void deallocate(void *ptr) {
+    if (!ptr) return;
+    Slot *slot = reinterpret_cast<Slot *>(ptr);
+    slot->next = freeList;
+    freeList = slot;
+    counts.live--;
+  }
+
+  const PoolStats &stats() const { return counts; }
+
+private:
+  union Slot {
+    Slot *next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  std::vector<Slot *> slabs;
+  Slot *freeList = nullptr;
+  PoolStats counts;
+
+  void grow() {
+    Slot *slab = static_cast<Slot *>(::operator new(sizeof(Slot) * SlabSize));
+    slabs.push_back(slab);
+    for (int i = SlabSize - 1; i >= 0; --i) {
+      slab[i].next = freeList;
+      freeList = &slab[i];
+    }
+    counts.capacity += SlabSize;
+  }
+};
+
+
+#endif //OBJECTPOOL_H
@@ -0,0 +1,178 @@
+#include "ParticleStore.h"
+#include <algorithm>
+
+void ParticleStore::grow(int total) {
+    x.resize(total, 0.0f);
+    y.resize(total, 0.0f);
+    prevX.resize(total, 0.0f);
+    prevY.resize(total, 0.0f);
+    invMass.resize(total, 0.0f);
+    flags.resize(total, 0);
+    counts.capacity = total;
+}
+
+void ParticleStore::reserve(int count) {
+    x.reserve(count);
+    y.reserve(count);
+    prevX.reserve(count);
+    prevY.reserve(count);
+    invMass.reserve(count);
+    flags.reserve(count);
+}
+
+int ParticleStore::allocate(int count) {
+    if (count <= 0) return size();
+
+    // Best fit among released ranges; exact matches (e.g. repeated inserts
+    // of the same rope length) end the search early.
+    int best = -1;
+    for (int r = 0; r < static_cast<int>(freeRanges.size()); ++r) {
+        int available = freeRanges[r].count;
+        if (available >= count && (best < 0 || available < freeRanges[best].count)) {
+            best = r;
+            if (available == count) break;
+        }
+    }
+
+    int first;
+    if (best >= 0) {
+        first = freeRanges[best].first;
+        freeRanges[best].first += count;
+        freeRanges[best].count -= count;
+        if (freeRanges[best].count == 0) freeRanges.erase(freeRanges.begin() + best);
+    } else if (!freeRanges.empty() && freeRanges.back().first + freeRanges.back().count == size()) {
+        // Extend a free tail instead of leaving it stranded.
+        first = freeRanges.back().first;
+        freeRanges.pop_back();
+        grow(first + count);
+    } else {
+        first = size();
+        grow(first + count);
+    }
+
+    claim(first, count);
+    return first;
+}
+
+void ParticleStore::claim(int first, int count) {
+    for (int i = first; i < first + count; ++i) {
+        invMass[i] = 1.0f;
+        flags[i] = PARTICLE_ALIVE;
+    }
+    counts.live += count;
+    counts.highWater = std::max(counts.highWater, counts.live);
+}
+
+bool ParticleStore::extendBack(int first, int count, int extra) {
+    if (extra <= 0) return true;
+    int end = first + count;
+
+    if (end == size()) {
+        grow(end + extra);
+        claim(end, extra);
+        return true;
+    }
+
+    auto it = std::lower_bound(freeRanges.begin(), freeRanges.end(), end,
+                               [](const Range &r, int value) { return r.first < value; });
+    if (it == freeRanges.end() || it->first != end) return false;
+
+    if (it->count > extra) {
+        it->first += extra;
+        it->count -= extra;
+    } else if (it->count == extra) {
+        freeRanges.erase(it);
+    } else if (it->first + it->count == size()) {
+        // Free tail that is too short: take it and grow the columns.
+        freeRanges.erase(it);
+        grow(end + extra);
+    } else {
+        return false;
+    }
+    claim(end, extra);
+    return true;
+}
+
+bool ParticleStore::extendFront(int &first, int extra) {
+    if (extra <= 0) return true;
+
+    auto it = std::lower_bound(freeRanges.begin(), freeRanges.end(), first,
+                               [](const Range &r, int value) { return r.first < value; });
+    if (it == freeRanges.begin()) return false;
+    --it;
+    if (it->first + it->count != first || it->count < extra) return false;
+
+    it->count -= extra;
+    if (it->count == 0) freeRanges.erase(it);
+    first -= extra;
+    claim(first, extra);
+    return true;
+}
+
+void ParticleStore::copyRange(int from, int n, int to) {
+    std::copy_n(x.begin() + from, n, x.begin() + to);
+    std::copy_n(y.begin() + from, n, y.begin() + to);
+    std::copy_n(prevX.begin() + from, n, prevX.begin() + to);
+    std::copy_n(prevY.begin() + from, n, prevY.begin() + to);
+    std::copy_n(invMass.begin() + from, n, invMass.begin() + to);
+    std::copy_n(flags.begin() + from, n, flags.begin() + to);
+}
+
+void ParticleStore::release(int first, int count) {
+    if (count <= 0) return;
+    for (int i = first; i < first + count; ++i) {
+        flags[i] = 0;
+        invMass[i] = 0.0f;
+    }
+    counts.live -= count;
+
+    // Insert keeping the list sorted, then merge with touching neighbours.
+    auto it = std::lower_bound(freeRanges.begin(), freeRanges.end(), first,
+                               [](const Range &r, int value) { return r.first < value; });
+    it = freeRanges.insert(it, {first, count});
+    if (it + 1 != freeRanges.end() && it->first + it->count == (it + 1)->first) {
+        it->count += (it + 1)->count;
+        freeRanges.erase(it + 1);
+    }
+    if (it != freeRanges.begin() && (it - 1)->first + (it - 1)->count == it->first) {
+        (it - 1)->count += it->count;
+        freeRanges.erase(it);
+    }
+}
+
+int ParticleStore::largestFreeRange() const {
+    int largest = 0;
+    for (const Range &r : freeRanges) largest = std::max(largest, r.count);
+    return largest;
+}
+
+void ParticleStore::init(int i, float px, float py) {
+    x[i] = px;
+    y[i] = py;
+    prevX[i] = px + 5;
+    prevY[i] = py + 5;
+}
+
+void ParticleStore::setFixed(int i, bool fixed) {
+    if (isFixed(i) != fixed) pinRevision++;
+    if (fixed) {
+        flags[i] |= PARTICLE_FIXED;
+        invMass[i] = 0.0f;
+    } else {
+        flags[i] &= ~PARTICLE_FIXED;
+        invMass[i] = 1.0f;
+    }
+}
+
+void ParticleStore::clear() {
+    x.clear();
+    y.clear();
+    prevX.clear();
+    prevY.clear();
+    invMass.clear();
+    flags.clear();
+    freeRanges.clear();
+    counts = PoolStats();
+    // Every pin is gone; anything built from the old ones must rebuild.
+    pinRevision++;
+}
@@ -0,0 +1,75 @@
+#ifndef PARTICLESTORE_H
+#define PARTICLESTORE_H
+#include <cstdint>
+#include <vector>
+
+#include "ObjectPool.h"
+
+enum ParticleFlags : uint8_t {
+  PARTICLE_ALIVE = 1 << 0,
+  PARTICLE_FIXED = 1 << 1,
+};
+
+// Structure-of-arrays storage for every rope node in the simulation.
+// Lines own contiguous index ranges into these columns, so the solver
+// passes walk plain float arrays instead of chasing heap pointers.
+// Released ranges go on a coalescing free list and are reused by later
+// allocations, so insert/delete cycles don't grow or fragment the columns.
+class ParticleStore {
+public:
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> prevX;
+  std::vector<float> prevY;
+  std::vector<float> invMass;
+  std::vector<uint8_t> flags;
+
+  // Reserves `count` consecutive particles and returns the first index.
+  int allocate(int count);
+  void release(int first, int count);
+  // Claims `extra` free particles directly after [first, first + count)
+  // (extendBack) or directly before `first` (extendFront). Returns false,
+  // claiming nothing, if that space is not free. On success extendFront
+  // returns the new first index through `first`.
+  bool extendBack(int first, int count, int extra);
+  bool extendFront(int &first, int extra);
+  // Copies every column of [from, from + n) to [to, to + n).
+  void copyRange(int from, int n, int to);
+
+  // Grows the columns ahead of time so allocations up to `count` particles
+  // don't reallocate.
+  void reserve(int count);
+
+  // Places particle `i` at rest-ish state (previous position offset like
+  // the original Node constructor did, giving new ropes a small kick).
+  void init(int i, float px, float py);
+
+  bool isFixed(int i) const { return flags[i] & PARTICLE_FIXED; }
+  void setFixed(int i, bool fixed);
+  // Bumped by every setFixed() that changes a particle, so anything derived
+  // from which nodes are pinned can tell when to rebuild.
+  uint64_t fixedRevision() const { return pinRevision; }
+
+  int size() const { return static_cast<int>(x.size()); }
+  void clear();
+
+  // live = allocated particles, capacity = column length.
+  const PoolStats &stats() const { return counts; }
+  int freeRangeCount() const { return static_cast<int>(freeRanges.size()); }
+  int largestFreeRange() const;
+
+private:
+  struct Range {
+    int first;
+    int count;
+  };
+  std::vector<Range> freeRanges;  // sorted by first, never adjacent
+  PoolStats counts;
+  uint64_t pinRevision = 0;
+
+  void grow(int total);
+  void claim(int first, int count);
+};
+
+
+#endif //PARTICLESTORE_H
@@ -0,0 +1,123 @@
+#include "Physics.h"
+#include <cmath>
+
+#include "VerletKernel.h"
+
+void integrateRange(ParticleStore &p, int first, int last, const DragInput &drag,
+                    float gravity, float timeStep, float damping) {
+    if (last <= first) return;
+
+    // The dragged node follows the cursor instead of integrating; keep its
+    // previous position so releasing it doesn't fling it.
+    const bool dragged = drag.node >= first && drag.node < last && !p.isFixed(drag.node);
+    float keepPrevX = dragged ? p.prevX[drag.node] : 0.0f;
+    float keepPrevY = dragged ? p.prevY[drag.node] : 0.0f;
+
+    IntegrateParams params;
+    params.damping = damping;
+    params.ay = gravity;
+    params.dt = timeStep;
+    integrateVerlet(p.x.data() + first, p.y.data() + first, p.prevX.data() + first, p.prevY.data() + first,
+                    p.invMass.data() + first, nullptr, nullptr, last - first, params);
+
+    if (dragged) {
+        p.x[drag.node] = drag.x;
+        p.y[drag.node] = drag.y;
+        p.prevX[drag.node] = keepPrevX;
+        p.prevY[drag.node] = keepPrevY;
+    }
+}
+
+float enforceMaxDistance(ParticleStore &p, int a, int b, float delta) {
+    float dx = p.x[b] - p.x[a];
+    float dy = p.y[b] - p.y[a];
+    float distSq = dx * dx + dy * dy;
+
+    float dist = sqrtf(distSq);
+    if (dist < 1e-6f) return delta > 0.0f ? 1.0f : 0.0f;
+
+    float diff = (dist - delta) / dist;
+    float offX = dx * 0.5f * diff;
+    float offY = dy * 0.5f * diff;
+
+    bool aFixed = p.isFixed(a);
+    bool bFixed = p.isFixed(b);
+    if (!aFixed && !bFixed) {
+        p.x[a] += offX; p.y[a] += offY;
+        p.x[b] -= offX; p.y[b] -= offY;
+    } else if (!aFixed) {
+        p.x[a] += offX * 2.0f; p.y[a] += offY * 2.0f;
+    } else if (!bFixed) {
+        p.x[b] -= offX * 2.0f; p.y[b] -= offY * 2.0f;
+    } else {
+        return 0.0f;
+    }
+    return delta > 0.0f ? fabsf(dist - delta) / delta : 0.0f;
+}
+
+float enforceDistanceXPBD(ParticleStore &p, int a, int b, float delta, float alphaTilde, float &lambda) {
+    const float wa = p.invMass[a];
+    const float wb = p.invMass[b];
+    const float w = wa + wb;
+    if (w <= 0.0f) return 0.0f;
+
+    float dx = p.x[b] - p.x[a];
+    float dy = p.y[b] - p.y[a];
+    float dist = sqrtf(dx * dx + dy * dy);
+    if (dist < 1e-6f) return delta > 0.0f ? 1.0f : 0.0f;
+
+    const float c = dist - delta;
+    const float residual = c + alphaTilde * lambda;
+    const float dLambda = -residual / (w + alphaTilde);
+    lambda += dLambda;
+
+    // Gradient of C is -n at a and +n at b.
+    const float nx = dx / dist;
+    const float ny = dy / dist;
+    p.x[a] -= wa * dLambda * nx; p.y[a] -= wa * dLambda * ny;
+    p.x[b] += wb * dLambda * nx; p.y[b] += wb * dLambda * ny;
+    return delta > 0.0f ? fabsf(residual) / delta : 0.0f;
+}
+
+void resolveNodeCollision(ParticleStore &p, int a, int b, float radiusSum) {
+    float dx = p.x[b] - p.x[a];
+    float dy = p.y[b] - p.y[a];
+    float distSq = dx * dx + dy * dy;
+
+    float minDist = radiusSum;
+    float minDistSq = minDist * minDist;
+
+    if (distSq >= minDistSq || distSq < 1e-6f) return;
+
+    float dist = sqrtf(distSq);
+    float overlap = minDist - dist;
+    float offsetAmount = overlap / dist * 0.5f;
+
+    float offX = dx * offsetAmount;
+    float offY = dy * offsetAmount;
+
+    bool aFixed = p.isFixed(a);
+    bool bFixed = p.isFixed(b);
+    if (!aFixed && !bFixed) {
+        p.x[a] -= offX; p.y[a] -= offY;
+        p.x[b] += offX; p.y[b] += offY;
+    } else if (!aFixed) {
+        p.x[a] -= offX * 2.0f; p.y[a] -= offY * 2.0f;
+    } else if (!bFixed) {
+        p.x[b] += offX * 2.0f; p.y[b] += offY * 2.0f;
+    }
+}
+
+void enforceWallCollision(ParticleStore &p, int i, float radius, float width, float height) {
+    if (p.isFixed(i)) return;
+
+    if (p.x[i] < radius)
+        p.x[i] = radius;
+    else if (p.x[i] > width - radius)
+        p.x[i] = width - radius;
+
+    if (p.y[i] < radius)
+        p.y[i] = radius;
+    else if (p.y[i] > height - radius)
+        p.y[i] = height - radius;
+}
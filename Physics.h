@@ -0,0 +1,35 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include "ParticleStore.h"
+
+#define BALL_RADIUS 10.0f
+#define DT 0.1f
+#define GRAVITY -10.0f
+#define DAMPING 0.999f
+
+// Particle currently pinned to the cursor. Passed into the step as plain
+// data so the solver never has to talk to the windowing layer.
+struct DragInput {
+  int node = -1;   // store index of the dragged particle, -1 for none
+  float x = 0.0f;
+  float y = 0.0f;
+};
+
+// Verlet-integrates particles [first, last) under gravity.
+void integrateRange(ParticleStore &p, int first, int last, const DragInput &drag,
+                    float gravity = GRAVITY, float timeStep = DT, float damping = DAMPING);
+
+// Projects a and b to distance delta; returns the relative stretch
+// |dist - delta| / delta before the correction, 0 if both are fixed.
+float enforceMaxDistance(ParticleStore &p, int a, int b, float delta);
+// XPBD projection of |b - a| = delta for alphaTilde = compliance / h^2,
+// weighted by inverse mass and accumulating into lambda (zero it at the
+// start of each substep). Returns the relative residual
+// |C + alphaTilde * lambda| / delta before the correction.
+float enforceDistanceXPBD(ParticleStore &p, int a, int b, float delta, float alphaTilde, float &lambda);
+void resolveNodeCollision(ParticleStore &p, int a, int b, float radiusSum);
+void enforceWallCollision(ParticleStore &p, int i, float radius, float width, float height);
+
+
+#endif //PHYSICS_H
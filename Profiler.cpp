@@ -0,0 +1,67 @@
+#include "Profiler.h"
+#include <algorithm>
+
+const char *profilePhaseName(ProfilePhase phase) {
+    switch (phase) {
+        case PHASE_INTEGRATE:       return "Integration";
+        case PHASE_CONSTRAINTS:     return "Constraints";
+        case PHASE_INTRA_COLLISION: return "Intra-line collision";
+        case PHASE_INTER_COLLISION: return "Inter-line collision";
+        case PHASE_WALLS:           return "Wall collision";
+        case PHASE_UPLOAD:          return "Buffer upload";
+        case PHASE_DRAW:            return "Draw";
+        default:                    return "Unknown";
+    }
+}
+
+Profiler::Profiler(int capacity) {
+    for (auto &s : samples) s.assign(std::max(1, capacity), 0.0f);
+}
+
+void Profiler::beginFrame() {
+    std::fill(std::begin(current), std::end(current), 0.0f);
+}
+
+void Profiler::endFrame() {
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        samples[p][head] = current[p];
+    }
+    head = (head + 1) % capacity();
+    filled = std::min(filled + 1, capacity());
+}
+
+void Profiler::add(ProfilePhase phase, float ms) {
+    current[phase] += ms;
+}
+
+float Profiler::last(ProfilePhase phase) const {
+    if (filled == 0) return 0.0f;
+    return samples[phase][(head + capacity() - 1) % capacity()];
+}
+
+PhaseSummary Profiler::summary(ProfilePhase phase) const {
+    PhaseSummary s;
+    if (filled == 0) return s;
+
+    // Only the frames written so far; before wrap-around they are [0, filled).
+    std::vector<float> sorted(samples[phase].begin(), samples[phase].begin() + filled);
+    std::sort(sorted.begin(), sorted.end());
+    auto at = [&sorted](float q) {
+        return sorted[static_cast<size_t>(q * (sorted.size() - 1) + 0.5f)];
+    };
+    s.p50 = at(0.50f);
+    s.p95 = at(0.95f);
+    s.p99 = at(0.99f);
+    return s;
+}
+
+ProfileScope::ProfileScope(Profiler *profiler, ProfilePhase phase)
+    : profiler(profiler), phase(phase) {
+    if (profiler) start = std::chrono::steady_clock::now();
+}
+
+ProfileScope::~ProfileScope() {
+    if (!profiler) return;
+    auto end = std::chrono::steady_clock::now();
+    profiler->add(phase, std::chrono::duration<float, std::milli>(end - start).count());
+}
@@ -0,0 +1,63 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <chrono>
+#include <vector>
+
+enum ProfilePhase {
+  PHASE_INTEGRATE,
+  PHASE_CONSTRAINTS,
+  PHASE_INTRA_COLLISION,
+  PHASE_INTER_COLLISION,
+  PHASE_WALLS,
+  PHASE_UPLOAD,
+  PHASE_DRAW,
+  PHASE_COUNT
+};
+
+const char *profilePhaseName(ProfilePhase phase);
+
+struct PhaseSummary {
+  float p50 = 0.0f;
+  float p95 = 0.0f;
+  float p99 = 0.0f;
+};
+
+// Per-phase frame timings kept in a rolling window of `capacity` frames.
+// Scopes add into the current frame, so substeps or per-line draw calls
+// that hit the same phase several times are summed. Times are in ms.
+class Profiler {
+public:
+  explicit Profiler(int capacity = 240);
+
+  void beginFrame();
+  void endFrame();
+  void add(ProfilePhase phase, float ms);
+
+  // Oldest-to-newest history for a phase is history(phase)[(offset() + k) % capacity()].
+  const std::vector<float> &history(ProfilePhase phase) const { return samples[phase]; }
+  int offset() const { return head; }
+  int capacity() const { return static_cast<int>(samples[0].size()); }
+  float last(ProfilePhase phase) const;
+  PhaseSummary summary(ProfilePhase phase) const;
+
+private:
+  std::vector<float> samples[PHASE_COUNT];
+  float current[PHASE_COUNT] = {};
+  int head = 0;
+  int filled = 0;
+};
+
+// Times its own lifetime into a phase. A null profiler makes it a no-op.
+class ProfileScope {
+public:
+  ProfileScope(Profiler *profiler, ProfilePhase phase);
+  ~ProfileScope();
+
+private:
+  Profiler *profiler;
+  ProfilePhase phase;
+  std::chrono::steady_clock::time_point start;
+};
+
+
+#endif //PROFILER_H
@@ -0,0 +1,43 @@
+#include "SceneIndex.h"
+
+bool SceneIndex::matches(const std::vector<Line*> &lines) const {
+    if (keys.size() != lines.size()) return false;
+    for (int l = 0; l < static_cast<int>(lines.size()); ++l) {
+        const Line *line = lines[l];
+        const LineKey &key = keys[l];
+        if (key.line != line || key.first != line->first || key.count != line->count ||
+            key.delta != line->delta || key.compliance != line->compliance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SceneIndex::refresh(const std::vector<Line*> &lines) {
+    if (!dirty && matches(lines)) return false;
+
+    nodes.clear();
+    nodeLine.clear();
+    lineOffset.clear();
+    keys.clear();
+    particleLine.clear();
+
+    lineOffset.push_back(0);
+    for (int l = 0; l < static_cast<int>(lines.size()); ++l) {
+        const Line *line = lines[l];
+        if (static_cast<int>(particleLine.size()) < line->first + line->size()) {
+            particleLine.resize(line->first + line->size(), -1);
+        }
+        for (int i = line->first; i < line->first + line->size(); ++i) {
+            nodes.push_back(i);
+            nodeLine.push_back(l);
+            particleLine[i] = l;
+        }
+        lineOffset.push_back(static_cast<int>(nodes.size()));
+        keys.push_back({line, line->first, line->count, line->delta, line->compliance});
+    }
+
+    dirty = false;
+    revision++;
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef SCENEINDEX_H
+#define SCENEINDEX_H
+#include <vector>
+
+#include "Line.h"
+
+// Flat view of which particles belong to which line, shared by the solver
+// and collision passes. It is only rebuilt when the topology changes: an
+// explicit invalidate() (cut, insert, delete) or a line whose range, rest
+// length or compliance no longer matches what was cached, which costs
+// O(lines) to detect rather than a walk over every node.
+class SceneIndex {
+public:
+  std::vector<int> nodes;       // particle indices, line by line
+  std::vector<int> nodeLine;    // position in `lines` of each entry's owner
+  std::vector<int> lineOffset;  // lines.size() + 1 offsets into nodes
+  std::vector<int> particleLine;  // owner of each store index, -1 if unowned
+
+  // Rebuilds if needed; returns true when the view changed.
+  bool refresh(const std::vector<Line*> &lines);
+  void invalidate() { dirty = true; }
+
+  unsigned version() const { return revision; }
+  int lineCount() const { return static_cast<int>(lineOffset.size()) - 1; }
+
+private:
+  struct LineKey {
+    const Line *line;
+    int first;
+    int count;
+    float delta;
+    float compliance;
+  };
+  std::vector<LineKey> keys;
+  bool dirty = true;
+  unsigned revision = 0;
+
+  bool matches(const std::vector<Line*> &lines) const;
+};
+
+
+#endif //SCENEINDEX_H
@@ -0,0 +1,357 @@
+#include "Simulation.h"
+#include <algorithm>
+#include <cmath>
+
+// Node count per parallel task for the per-node phases; enough work to
+// amortise a queue operation and a timer read.
+#define PARALLEL_CHUNK_NODES 2048
+
+Simulation::Simulation()
+    : broadPhase(BALL_RADIUS * 2.0f) {
+}
+
+Simulation::~Simulation() {
+    clear();
+}
+
+Line *Simulation::addLine(float delta, int numPoints, float *start) {
+    Line *line = new Line(particles, delta, numPoints, start);
+    line->compliance = params.compliance;
+    lines.push_back(line);
+    topologyChanged();
+    return line;
+}
+
+void Simulation::removeLine(Line *line) {
+    auto it = std::find(lines.begin(), lines.end(), line);
+    if (it != lines.end()) {
+        wakeNeighbours(line);
+        delete *it;
+        lines.erase(it);
+        topologyChanged();
+    }
+}
+
+std::pair<Line*, Line*> Simulation::splitLine(Line *line, int pos) {
+    auto it = std::find(lines.begin(), lines.end(), line);
+    if (it == lines.end()) return {nullptr, nullptr};
+
+    wakeNeighbours(line);
+    auto halves = line->split(pos);
+    *it = halves.first;
+    lines.push_back(halves.second);
+    delete line;
+    topologyChanged();
+    return halves;
+}
+
+Line *Simulation::joinLines(Line *front, Line *back) {
+    auto it = std::find(lines.begin(), lines.end(), back);
+    if (front == back || it == lines.end()) return front;
+
+    wakeNeighbours(front);
+    wakeNeighbours(back);
+    wake(front);
+    front->newTail(back);
+    lines.erase(it);
+    delete back;
+    topologyChanged();
+    return front;
+}
+
+void Simulation::moveLine(Line *line, float dx, float dy) {
+    wakeNeighbours(line);
+    for (int i = line->first; i < line->first + line->size(); ++i) {
+        particles.x[i] += dx;
+        particles.y[i] += dy;
+        particles.prevX[i] += dx;
+        particles.prevY[i] += dy;
+    }
+    wake(line);
+}
+
+void Simulation::setCompliance(float compliance) {
+    params.compliance = compliance;
+    for (Line *line : lines) line->compliance = compliance;
+    solverDirty = true;
+}
+
+void Simulation::clear() {
+    for (Line *line : lines) delete line;
+    lines.clear();
+    topologyChanged();
+    lastX.clear();
+    lastY.clear();
+    intraPairs.clear();
+    interPairs.clear();
+}
+
+int Simulation::nodeCount() const {
+    int total = 0;
+    for (const Line *line : lines) total += line->size();
+    return total;
+}
+
+uint64_t Simulation::stateHash() const {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void *data, size_t bytes) {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        for (size_t k = 0; k < bytes; ++k) {
+            hash ^= p[k];
+            hash *= 1099511628211ull;
+        }
+    };
+    for (const Line *line : lines) {
+        const int count = line->size();
+        mix(&count, sizeof(count));
+        const int first = line->first;
+        mix(particles.x.data() + first, count * sizeof(float));
+        mix(particles.y.data() + first, count * sizeof(float));
+        mix(particles.prevX.data() + first, count * sizeof(float));
+        mix(particles.prevY.data() + first, count * sizeof(float));
+        mix(particles.flags.data() + first, count * sizeof(uint8_t));
+    }
+    return hash;
+}
+
+int Simulation::sleepingLineCount() const {
+    int total = 0;
+    for (const Line *line : lines) total += line->asleep;
+    return total;
+}
+
+void Simulation::wake(Line *line) {
+    line->restSteps = 0;
+    if (line->asleep) {
+        line->asleep = false;
+        solverDirty = true;
+    }
+}
+
+void Simulation::wakeParticle(int i) {
+    if (i < 0 || i >= static_cast<int>(sceneIndex.particleLine.size())) return;
+    int l = sceneIndex.particleLine[i];
+    if (l >= 0 && l < static_cast<int>(lines.size())) wake(lines[l]);
+}
+
+// Lines resting on an edited line lose their support; wake every line
+// that was a collision candidate with it in the last step. Owners are found
+// from the current node ranges, not the scene index: an earlier edit in
+// the same frame may already have moved lines around in `lines`.
+void Simulation::wakeNeighbours(const Line *line) {
+    const int end = line->first + line->size();
+    wakeCandidates.clear();
+    for (const CollisionPair &pair : interPairs) {
+        if (pair.a >= line->first && pair.a < end) wakeCandidates.push_back(pair.b);
+        else if (pair.b >= line->first && pair.b < end) wakeCandidates.push_back(pair.a);
+    }
+    if (wakeCandidates.empty()) return;
+
+    std::sort(wakeCandidates.begin(), wakeCandidates.end());
+    for (Line *other : lines) {
+        if (other == line) continue;
+        auto it = std::lower_bound(wakeCandidates.begin(), wakeCandidates.end(), other->first);
+        if (it != wakeCandidates.end() && *it < other->first + other->size()) wake(other);
+    }
+}
+
+void Simulation::collide(const CollisionPair &pair, float radiusSum) {
+    Line *lineA = lines[sceneIndex.particleLine[pair.a]];
+    Line *lineB = lines[sceneIndex.particleLine[pair.b]];
+    if (lineA->asleep || lineB->asleep) {
+        if (lineA->asleep && lineB->asleep) return;
+        // Wake on contact, with a little slack so a node resting exactly at
+        // contact distance from a sleeper still counts as touching it.
+        float dx = particles.x[pair.b] - particles.x[pair.a];
+        float dy = particles.y[pair.b] - particles.y[pair.a];
+        float reach = radiusSum * 1.05f;
+        if (dx * dx + dy * dy >= reach * reach) return;
+        wake(lineA->asleep ? lineA : lineB);
+    }
+    resolveNodeCollision(particles, pair.a, pair.b, radiusSum);
+}
+
+void Simulation::updateSleep(float h) {
+    if (params.sleepEnergy <= 0.0f) {
+        for (Line *line : lines) wake(line);
+        return;
+    }
+
+    const float toEnergy = 0.5f / (h * h);  // displacement^2 per step -> 0.5 v^2
+    for (Line *line : lines) {
+        if (line->asleep) continue;
+        float peak = 0.0f;
+        for (int i = line->first; i < line->first + line->size(); ++i) {
+            if (particles.isFixed(i)) continue;  // pinned: prev may be stale
+            float vx = particles.x[i] - particles.prevX[i];
+            float vy = particles.y[i] - particles.prevY[i];
+            peak = std::max(peak, vx * vx + vy * vy);
+        }
+        if (peak * toEnergy >= params.sleepEnergy) {
+            line->restSteps = 0;
+        } else if (++line->restSteps >= params.sleepSteps) {
+            // Freeze in place: zero velocity so it wakes from rest.
+            line->asleep = true;
+            solverDirty = true;
+            for (int i = line->first; i < line->first + line->size(); ++i) {
+                particles.prevX[i] = particles.x[i];
+                particles.prevY[i] = particles.y[i];
+            }
+        }
+    }
+}
+
+void Simulation::buildSpans() {
+    spans.clear();
+    taskSpans.clear();
+    int taskNodes = PARALLEL_CHUNK_NODES;
+    for (const Line *line : lines) {
+        if (line->asleep) continue;
+        const int end = line->first + line->size();
+        for (int first = line->first; first < end; first += PARALLEL_CHUNK_NODES) {
+            const int last = std::min(end, first + PARALLEL_CHUNK_NODES);
+            if (taskNodes + (last - first) > PARALLEL_CHUNK_NODES) {
+                taskSpans.push_back(static_cast<int>(spans.size()));
+                taskNodes = 0;
+            }
+            spans.push_back({first, last});
+            taskNodes += last - first;
+        }
+    }
+    taskSpans.push_back(static_cast<int>(spans.size()));
+}
+
+void Simulation::forEachSpan(const std::function<void(int, int)> &fn) {
+    buildSpans();
+    const int tasks = static_cast<int>(taskSpans.size()) - 1;
+    auto runTasks = [&](int begin, int end) {
+        for (int s = taskSpans[begin]; s < taskSpans[end]; ++s) fn(spans[s].first, spans[s].last);
+    };
+    if (jobs) jobs->parallelFor(tasks, 1, runTasks);
+    else runTasks(0, tasks);
+}
+
+// Pairs within one line can share nodes, pairs of different lines can't:
+// bucket by line, keeping the grid's order inside each bucket, and give
+// each line to one worker. The result is the same for any thread count.
+void Simulation::resolveIntraPairs() {
+    const int lineCount = static_cast<int>(lines.size());
+    pairOffset.assign(lineCount + 1, 0);
+    for (const CollisionPair &pair : intraPairs) pairOffset[sceneIndex.particleLine[pair.a] + 1]++;
+    for (int l = 0; l < lineCount; ++l) pairOffset[l + 1] += pairOffset[l];
+    linePairs.resize(intraPairs.size());
+    pairCursor.assign(pairOffset.begin(), pairOffset.end() - 1);
+    for (const CollisionPair &pair : intraPairs) linePairs[pairCursor[sceneIndex.particleLine[pair.a]]++] = pair;
+
+    const float radiusSum = params.radius * 2.0f;
+    auto resolveLines = [&](int begin, int end) {
+        for (int k = pairOffset[begin]; k < pairOffset[end]; ++k) {
+            resolveNodeCollision(particles, linePairs[k].a, linePairs[k].b, radiusSum);
+        }
+    };
+    if (jobs && linePairs.size() >= PARALLEL_CHUNK_NODES) {
+        jobs->parallelFor(lineCount, std::max(1, lineCount / (jobs->threadCount() * 8)), resolveLines);
+    } else {
+        resolveLines(0, lineCount);
+    }
+}
+
+void Simulation::step(const DragInput &drag) {
+    const int substeps = std::max(1, params.substeps);
+    const float h = params.timeStep / substeps;
+    const float damping = substeps == 1 ? params.damping : std::pow(params.damping, 1.0f / substeps);
+
+    if (sceneIndex.refresh(lines)) {
+        solverDirty = true;
+    }
+    if (drag.node >= 0) {
+        wakeParticle(drag.node);
+    }
+
+    {
+        ProfileScope scope(profiler, PHASE_INTEGRATE);
+        forEachSpan([&](int first, int last) {
+            integrateRange(particles, first, last, drag, params.gravity, h, damping);
+        });
+    }
+
+    {
+        ProfileScope scope(profiler, PHASE_CONSTRAINTS);
+        if (solverDirty || solverFixedRevision != particles.fixedRevision()) {
+            awakeLines.clear();
+            for (Line *line : lines) {
+                if (!line->asleep) awakeLines.push_back(line);
+            }
+            solver.build(awakeLines);
+            solverDirty = false;
+            solverFixedRevision = particles.fixedRevision();
+        }
+        SolverSettings settings;
+        settings.mode = params.solverMode;
+        settings.timeStep = h;
+        settings.maxIterations = params.iterations;
+        settings.attachments = params.longRangeAttachments;
+        settings.relaxation = params.jacobiRelaxation;
+        settings.maxStretchTolerance = params.maxStretchTolerance;
+        settings.rmsStretchTolerance = params.rmsStretchTolerance;
+        settings.budget = params.iterationBudget;
+        settings.jobs = jobs;
+        solver.solve(particles, settings);
+    }
+
+    // Intra- and inter-line node collisions via the grid broad phase. The
+    // grid build is charged to the intra-line pass, which runs first.
+    {
+        ProfileScope scope(profiler, PHASE_INTRA_COLLISION);
+        broadPhase.setCellSize(params.radius * 2.0f);
+        lineAwake.resize(lines.size());
+        for (int l = 0; l < static_cast<int>(lines.size()); ++l) {
+            lineAwake[l] = !lines[l]->asleep;
+        }
+        broadPhase.build(particles, sceneIndex, lineAwake.data());
+        broadPhase.findPairs(intraPairs, interPairs);
+        resolveIntraPairs();
+    }
+    {
+        ProfileScope scope(profiler, PHASE_INTER_COLLISION);
+        for (const CollisionPair &pair : interPairs) {
+            collide(pair, params.radius * 2.0f);
+        }
+    }
+
+    {
+        ProfileScope scope(profiler, PHASE_WALLS);
+        forEachSpan([&](int first, int last) {
+            for (int i = first; i < last; ++i) {
+                enforceWallCollision(particles, i, params.radius, params.width, params.height);
+            }
+        });
+    }
+
+    updateSleep(h);
+}
+
+int Simulation::advance(FixedTimestep &clock, double frameSeconds, const DragInput &drag) {
+    clock.substeps = std::max(1, params.substeps);
+    int steps = clock.consume(frameSeconds);
+    for (int s = 0; s < steps; ++s) {
+        if (s == steps - 1) capturePrevious();
+        step(drag);
+    }
+    return steps;
+}
+
+void Simulation::capturePrevious() {
+    lastX = particles.x;
+    lastY = particles.y;
+}
+
+float Simulation::renderX(int i, float alpha) const {
+    if (i >= static_cast<int>(lastX.size())) return particles.x[i];
+    return lastX[i] + (particles.x[i] - lastX[i]) * alpha;
+}
+
+float Simulation::renderY(int i, float alpha) const {
+    if (i >= static_cast<int>(lastY.size())) return particles.y[i];
+    return lastY[i] + (particles.y[i] - lastY[i]) * alpha;
+}
@@ -0,0 +1,153 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+#include <vector>
+
+#include "ConstraintSolver.h"
+#include "FixedTimestep.h"
+#include "JobSystem.h"
+#include "Line.h"
+#include "Physics.h"
+#include "Profiler.h"
+#include "SceneIndex.h"
+#include "UniformGrid.h"
+
+struct SimulationParams {
+  float gravity = GRAVITY;
+  float timeStep = DT;
+  float damping = DAMPING;
+  // Each step() advances timeStep / substeps; damping is rescaled so the
+  // per-timeStep damping is the same for any substep count.
+  int substeps = 1;
+  float radius = BALL_RADIUS;
+  // Constraint sweeps per step: each line stops once its relative stretch
+  // |dist - rest| / rest is under both tolerances, or after `iterations`
+  // sweeps. iterationBudget caps constraint projections per step across
+  // all lines (0 = unlimited).
+  int iterations = 8;
+  SolverMode solverMode = SOLVER_PBD;
+  // Over-relaxation of SOLVER_JACOBI's averaged corrections.
+  float jacobiRelaxation = 1.5f;
+  // Long-range attachments from free nodes to their line's pinned nodes.
+  // Compliant lines skip them under XPBD and DIRECT.
+  bool longRangeAttachments = true;
+  // Segment compliance given to lines as they are added (see setCompliance).
+  float compliance = 0.0f;
+  float maxStretchTolerance = 0.01f;
+  float rmsStretchTolerance = 0.005f;
+  long long iterationBudget = 0;
+  // Wall bounds; the GUI keeps these in sync with the framebuffer.
+  float width = 800.0f;
+  float height = 600.0f;
+  // A line falls asleep (skipping integration, constraints and walls) once
+  // the kinetic energy of its fastest node, 0.5 * v^2 per unit mass, has
+  // stayed below sleepEnergy for sleepSteps steps. 0 disables sleeping.
+  float sleepEnergy = 0.05f;
+  int sleepSteps = 60;
+};
+
+// The whole rope world: particle storage, the lines indexing into it and
+// one fixed step of physics. Has no windowing or GL dependency.
+class Simulation {
+public:
+  ParticleStore particles;
+  std::vector<Line*> lines;
+  SimulationParams params;
+  // Optional per-phase timing sink; the owner begins/ends its frames.
+  Profiler *profiler = nullptr;
+  // Optional worker pool for the per-line phases (integration, constraint
+  // solve, intra-line collisions, walls); they run serially when null.
+  JobSystem *jobs = nullptr;
+
+  Simulation();
+  ~Simulation();
+
+  Line *addLine(float delta, int numPoints, float *start);
+  void removeLine(Line *line);
+  // Cuts `line` before node `pos`; the head replaces it in `lines`, the
+  // tail is appended. `line` is deleted.
+  std::pair<Line*, Line*> splitLine(Line *line, int pos);
+  // Appends `back` to `front` and removes `back` from the scene.
+  Line *joinLines(Line *front, Line *back);
+  // Shifts every node of `line` (positions and previous positions) by
+  // (dx, dy), waking it and the lines that were touching it.
+  void moveLine(Line *line, float dx, float dy);
+  // Call after editing lines directly (split/concat outside Simulation).
+  void topologyChanged() {
+    sceneIndex.invalidate();
+    topologyCount++;
+  }
+  // Bumped by every add, remove, split, join, clear and topologyChanged(),
+  // so anything that maps nodes by their line order can tell when it
+  // changed, even if the node count did not.
+  uint64_t topologyRevision() const { return topologyCount; }
+  // Sets params.compliance and the compliance of every existing line.
+  void setCompliance(float compliance);
+  void clear();
+
+  void step(const DragInput &drag = DragInput());
+  // Runs as many substeps as the clock has accumulated for this frame and
+  // snapshots the state before the last one for interpolation.
+  int advance(FixedTimestep &clock, double frameSeconds, const DragInput &drag = DragInput());
+
+  // Position of particle i blended between the last two physics states.
+  float renderX(int i, float alpha) const;
+  float renderY(int i, float alpha) const;
+
+  int nodeCount() const;
+  // FNV-1a over the bit patterns of every line's positions, previous
+  // positions and pins, in line order. Equal hashes mean bit-identical
+  // states, e.g. between runs with different thread counts.
+  uint64_t stateHash() const;
+  int sleepingLineCount() const;
+  void wake(Line *line);
+  const BroadPhaseStats &broadPhaseStats() const { return broadPhase.stats(); }
+  // Sweeps and residuals of the last step's constraint solve.
+  const SolverStats &solverStats() const { return solver.stats(); }
+
+private:
+  SceneIndex sceneIndex;
+  uint64_t topologyCount = 0;
+  UniformGrid broadPhase;
+  std::vector<CollisionPair> intraPairs;
+  std::vector<CollisionPair> interPairs;
+  ConstraintSolver solver;
+  bool solverDirty = true;       // the set of awake lines changed
+  uint64_t solverFixedRevision = 0;  // particles.fixedRevision() at the last build
+  std::vector<Line*> awakeLines;
+  std::vector<uint8_t> lineAwake;  // per position in `lines`, for the broad phase
+  std::vector<float> lastX;
+  std::vector<float> lastY;
+
+  // Awake node ranges, long lines cut into pieces of at most
+  // PARALLEL_CHUNK_NODES; task t covers spans [taskSpans[t], taskSpans[t + 1]),
+  // consecutive short lines packed together up to the same size.
+  struct NodeSpan {
+    int first;
+    int last;
+  };
+  std::vector<NodeSpan> spans;
+  std::vector<int> taskSpans;
+  // intraPairs bucketed by line: line l's pairs are
+  // [pairOffset[l], pairOffset[l + 1]) of linePairs.
+  std::vector<int> pairOffset;
+  std::vector<int> pairCursor;
+  std::vector<CollisionPair> linePairs;
+  std::vector<int> wakeCandidates;  // wakeNeighbours() scratch
+
+  void capturePrevious();
+  void buildSpans();
+  // Runs fn(first, last) over every awake node range, in parallel if there
+  // is a job system.
+  void forEachSpan(const std::function<void(int, int)> &fn);
+  void resolveIntraPairs();
+  // Needs a fresh scene index, i.e. only during step().
+  void wakeParticle(int i);
+  void wakeNeighbours(const Line *line);
+  // Resolves a collision candidate, skipping pairs where both lines sleep
+  // and waking a sleeper that an awake node comes into contact with.
+  void collide(const CollisionPair &pair, float radiusSum);
+  void updateSleep(float h);
+};
+
+
+#endif //SIMULATION_H
@@ -0,0 +1,263 @@
+#include "SimulationThread.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "Snapshot.h"
+
+float RenderSnapshot::alpha(double now) const {
+    if (substepSeconds <= 0.0) return 1.0f;
+    return static_cast<float>(std::clamp((now - time) / substepSeconds, 0.0, 1.0));
+}
+
+// One pool thread fewer than the hardware offers leaves a core for the
+// render thread; this thread is worker 0.
+SimulationThread::SimulationThread()
+    : jobs(std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1)) {
+}
+
+SimulationThread::~SimulationThread() {
+    stop();
+}
+
+double SimulationThread::now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SimulationThread::start() {
+    if (running) return;
+    sim.profiler = &profiler;
+    if (jobs.threadCount() > 1) sim.jobs = &jobs;
+    running = true;
+    thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop() {
+    if (!running) return;
+    running = false;
+    thread.join();
+    recorder.close();
+}
+
+bool SimulationThread::post(const SimCommand &command) {
+    return commands.push(command);
+}
+
+void SimulationThread::drag(uint32_t line, int node, float x, float y) {
+    drags.back() = {line, node, x, y};
+    drags.publish();
+}
+
+void SimulationThread::endDrag() {
+    drags.back() = DragTarget();
+    drags.publish();
+}
+
+const RenderSnapshot &SimulationThread::latest() {
+    snapshots.refresh();
+    return snapshots.front();
+}
+
+Line *SimulationThread::findLine(uint32_t id) {
+    for (Line *line : sim.lines) {
+        if (line->id == id) return line;
+    }
+    return nullptr;
+}
+
+void SimulationThread::run() {
+    double last = now();
+    rateStart = last;
+    publish(false);
+
+    while (running) {
+        const bool edited = applyCommands();
+        const double t = now();
+        const double frameSeconds = t - last;
+        last = t;
+
+        int steps = 0;
+        if (!paused) {
+            DragInput drag;
+            Line *line = dragNode >= 0 ? findLine(dragLine) : nullptr;
+            if (line && dragNode < line->size()) {
+                drag.node = line->first + dragNode;
+                drag.x = dragX;
+                drag.y = dragY;
+            }
+            profiler.beginFrame();
+            steps = sim.advance(clock, frameSeconds, drag);
+            profiler.endFrame();
+            if (steps > 0) {
+                for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+                    phaseMs[phase] = profiler.last(static_cast<ProfilePhase>(phase));
+                }
+                phaseSequence++;
+                recorder.capture(sim);
+            }
+        } else {
+            clock.reset();
+        }
+
+        stepsSinceRate += steps;
+        if (t - rateStart >= 0.5) {
+            stepsPerSecond = stepsSinceRate / (t - rateStart);
+            stepsSinceRate = 0;
+            rateStart = t;
+            workerUtilisation.resize(jobs.threadCount());
+            for (int w = 0; w < jobs.threadCount(); ++w) {
+                workerUtilisation[w] = static_cast<float>(jobs.utilisation(w));
+            }
+            jobs.resetStats();
+        }
+
+        if (steps > 0 || edited) publish(steps > 0);
+
+        // Sleep until the next substep is due; a posted command waits at
+        // most that long.
+        const double wait = paused ? 0.005 : (1.0 - clock.alpha()) * clock.substepSeconds();
+        std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+    }
+}
+
+bool SimulationThread::applyCommands() {
+    // Only a new drag target overrides the state, so an edit that ended
+    // the drag (cut, delete, load) sticks until the render thread sends
+    // another one.
+    if (drags.refresh()) {
+        const DragTarget &target = drags.front();
+        dragLine = target.line;
+        dragNode = target.node;
+        dragX = target.x;
+        dragY = target.y;
+    }
+
+    bool any = false;
+    SimCommand command;
+    while (commands.pop(command)) {
+        apply(command);
+        any = true;
+    }
+    return any;
+}
+
+void SimulationThread::apply(const SimCommand &command) {
+    Line *line = findLine(command.line);
+    const bool validNode = line && command.node >= 0 && command.node < line->size();
+
+    switch (command.type) {
+        case CMD_TOGGLE_FIXED:
+            if (!validNode) break;
+            line->getNode(command.node).setFixed(!line->getNode(command.node).isFixed());
+            sim.wake(line);
+            break;
+        case CMD_CUT:
+            if (!validNode) break;
+            if (command.line == dragLine) dragNode = -1;
+            sim.splitLine(line, command.node).second->root().setFixed(true);
+            break;
+        case CMD_INSERT: {
+            if (command.value < 1) break;
+            float start[3] = {command.x, command.y, 0.0f};
+            Line *inserted = sim.addLine(command.delta, command.value, start);
+            inserted->getNode(std::clamp(command.node, 0, inserted->size() - 1)).setFixed(true);
+            break;
+        }
+        case CMD_DELETE:
+            if (!line) break;
+            if (command.line == dragLine) dragNode = -1;
+            sim.removeLine(line);
+            break;
+        case CMD_MOVE_LINE:
+            if (!line) break;
+            sim.moveLine(line, command.x, command.y);
+            break;
+        case CMD_PAUSE:
+            paused = command.value != 0;
+            break;
+        case CMD_SUBSTEPS:
+            sim.params.substeps = std::max(1, command.value);
+            break;
+        case CMD_MAX_CATCH_UP:
+            clock.maxStepsPerFrame = std::max(1, command.value);
+            break;
+        case CMD_BOUNDS:
+            sim.params.width = command.x;
+            sim.params.height = command.y;
+            break;
+        case CMD_SAVE:
+            if (saveSnapshot(sim, command.path))
+                std::cout << "Saved snapshot to " << command.path << "\n";
+            break;
+        case CMD_LOAD: {
+            // The window, not the file, decides the walls.
+            float width = sim.params.width, height = sim.params.height;
+            dragNode = -1;
+            if (loadSnapshot(sim, command.path))
+                std::cout << "Loaded snapshot from " << command.path << "\n";
+            sim.params.width = width;
+            sim.params.height = height;
+            break;
+        }
+        case CMD_SOLVER:
+            if (command.value >= 0 && command.value < SOLVER_MODE_COUNT)
+                sim.params.solverMode = static_cast<SolverMode>(command.value);
+            break;
+        case CMD_COMPLIANCE:
+            sim.setCompliance(std::max(0.0f, command.x));
+            break;
+        case CMD_ATTACHMENTS:
+            sim.params.longRangeAttachments = command.value != 0;
+            break;
+        case CMD_RECORD:
+            if (command.value) recorder.open(command.path);
+            else recorder.close();
+            break;
+    }
+}
+
+void SimulationThread::publish(bool stepped) {
+    RenderSnapshot &s = snapshots.back();
+    const int n = sim.nodeCount();
+    s.lines.resize(sim.lines.size());
+    s.x.resize(n);
+    s.y.resize(n);
+    s.lastX.resize(n);
+    s.lastY.resize(n);
+    s.fixed.resize(n);
+
+    int packed = 0;
+    for (int l = 0; l < static_cast<int>(sim.lines.size()); ++l) {
+        const Line *line = sim.lines[l];
+        s.lines[l] = {line->id, packed, line->size()};
+        for (int i = line->first; i < line->first + line->size(); ++i, ++packed) {
+            s.x[packed] = sim.particles.x[i];
+            s.y[packed] = sim.particles.y[i];
+            // Without a step there is nothing to blend from.
+            s.lastX[packed] = stepped ? sim.renderX(i, 0.0f) : s.x[packed];
+            s.lastY[packed] = stepped ? sim.renderY(i, 0.0f) : s.y[packed];
+            s.fixed[packed] = sim.particles.isFixed(i);
+        }
+    }
+
+    s.time = now();
+    s.substepSeconds = clock.substepSeconds();
+    s.paused = paused;
+    s.lastSteps = clock.lastSteps();
+    s.droppedSteps = clock.droppedSteps();
+    s.stepsPerSecond = stepsPerSecond;
+    s.broadPhase = sim.broadPhaseStats();
+    s.solver = sim.solverStats();
+    s.sleepingLines = sim.sleepingLineCount();
+    s.nodePool = sim.particles.stats();
+    s.linePool = Line::poolStats();
+    s.freeRanges = sim.particles.freeRangeCount();
+    s.largestFreeRange = sim.particles.largestFreeRange();
+    std::copy(phaseMs, phaseMs + PHASE_COUNT, s.phaseMs);
+    s.phaseSequence = phaseSequence;
+    s.recording = recorder.recording();
+    s.recorder = recorder.stats();
+    s.workerUtilisation = workerUtilisation;
+
+    snapshots.publish();
+}
@@ -0,0 +1,159 @@
+#ifndef SIMULATIONTHREAD_H
+#define SIMULATIONTHREAD_H
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "JobSystem.h"
+#include "Simulation.h"
+#include "SpscQueue.h"
+#include "TrajectoryRecorder.h"
+#include "TripleBuffer.h"
+
+// Edits posted to the simulation thread. Lines are named by Line::id and
+// nodes by their position in the line, both as seen in a RenderSnapshot;
+// commands naming a line that no longer exists are ignored. Dragging is not
+// a command: see SimulationThread::drag().
+enum SimCommandType {
+  CMD_TOGGLE_FIXED,  // line, node
+  CMD_CUT,           // line, node: cut before node, pin the new tail's root
+  CMD_INSERT,        // x, y start, delta spacing, value nodes, node to pin
+  CMD_DELETE,        // line
+  CMD_MOVE_LINE,     // line, x, y offset
+  CMD_PAUSE,         // value != 0 pauses
+  CMD_SUBSTEPS,      // value
+  CMD_MAX_CATCH_UP,  // value
+  CMD_BOUNDS,        // x, y = width, height
+  CMD_SAVE,          // path
+  CMD_LOAD,          // path
+  CMD_RECORD,        // value != 0 starts recording to path, 0 stops
+  CMD_SOLVER,        // value = SolverMode
+  CMD_COMPLIANCE,    // x, for every line and the ones added later
+  CMD_ATTACHMENTS,   // value != 0 enables long-range attachments
+};
+
+struct SimCommand {
+  SimCommandType type;
+  uint32_t line = 0;
+  int node = 0;
+  float x = 0.0f;
+  float y = 0.0f;
+  float delta = 0.0f;
+  int value = 0;
+  const char *path = nullptr;  // not copied: must outlive the command
+};
+
+// Where the render thread wants a dragged node; node < 0 is no drag.
+struct DragTarget {
+  uint32_t line = 0;
+  int node = -1;
+  float x = 0.0f;
+  float y = 0.0f;
+};
+
+struct RenderLine {
+  uint32_t id;
+  int first;  // into the snapshot arrays, not the particle store
+  int count;
+};
+
+// Immutable copy of everything the render thread shows. Lines are packed
+// one after another; lastX/lastY hold the state one substep earlier so
+// the renderer can interpolate between the two.
+struct RenderSnapshot {
+  std::vector<RenderLine> lines;
+  std::vector<float> x, y;
+  std::vector<float> lastX, lastY;
+  std::vector<uint8_t> fixed;
+  double time = 0.0;         // SimulationThread::now() at publish
+  double substepSeconds = 1.0 / 60.0;
+
+  // Stats for the UI.
+  bool paused = false;
+  int lastSteps = 0;
+  long long droppedSteps = 0;
+  double stepsPerSecond = 0.0;
+  BroadPhaseStats broadPhase;
+  SolverStats solver;
+  int sleepingLines = 0;
+  PoolStats nodePool;
+  PoolStats linePool;
+  int freeRanges = 0;
+  int largestFreeRange = 0;
+  float phaseMs[PHASE_COUNT] = {};  // physics phases of the latest update
+  uint64_t phaseSequence = 0;       // bumped by each update phaseMs comes from
+  bool recording = false;
+  RecorderStats recorder;
+  std::vector<float> workerUtilisation;  // per worker, over the last rate window
+
+  // Blend factor between lastX and x for a frame drawn at `now`.
+  float alpha(double now) const;
+  int nodeCount() const { return static_cast<int>(x.size()); }
+};
+
+// Runs a Simulation on its own thread against the wall clock, at its
+// FixedTimestep rate regardless of how fast frames are drawn. Input comes
+// in through a lock-free command queue and state goes out through a
+// lock-free triple buffer of RenderSnapshots, so neither side ever waits
+// for the other.
+class SimulationThread {
+public:
+  SimulationThread();
+  ~SimulationThread();
+
+  SimulationThread(const SimulationThread &) = delete;
+  SimulationThread &operator=(const SimulationThread &) = delete;
+
+  // Direct access for building the initial scene; only valid while the
+  // thread is not running.
+  Simulation &simulation() { return sim; }
+
+  void start();
+  void stop();
+
+  // Returns false (dropping the command) if the queue is full.
+  bool post(const SimCommand &command);
+  // Node `node` of line `line` follows (x, y) until endDrag(). Goes through
+  // a latest-value slot, not the queue, so following the cursor every frame
+  // can't fill the queue and only the newest target is ever applied.
+  void drag(uint32_t line, int node, float x, float y);
+  void endDrag();
+  // Newest published snapshot. Render thread only.
+  const RenderSnapshot &latest();
+
+  static double now();
+
+private:
+  Simulation sim;
+  JobSystem jobs;
+  FixedTimestep clock;
+  Profiler profiler;
+  TrajectoryRecorder recorder;
+  SpscQueue<SimCommand, 1024> commands;
+  TripleBuffer<RenderSnapshot> snapshots;
+  TripleBuffer<DragTarget> drags;
+  std::thread thread;
+  std::atomic<bool> running{false};
+
+  // Simulation-thread state.
+  bool paused = false;
+  uint32_t dragLine = 0;
+  int dragNode = -1;
+  float dragX = 0.0f, dragY = 0.0f;
+  long long stepsSinceRate = 0;
+  double rateStart = 0.0;
+  double stepsPerSecond = 0.0;
+  std::vector<float> workerUtilisation;
+  float phaseMs[PHASE_COUNT] = {};  // of the latest update that stepped
+  uint64_t phaseSequence = 0;
+
+  void run();
+  bool applyCommands();
+  void apply(const SimCommand &command);
+  void publish(bool stepped);
+  Line *findLine(uint32_t id);
+};
+
+
+#endif //SIMULATIONTHREAD_H
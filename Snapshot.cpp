@@ -0,0 +1,301 @@
+#include "Snapshot.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static size_t align16(size_t offset) {
+    return (offset + 15) & ~static_cast<size_t>(15);
+}
+
+// Byte offsets of each block for a snapshot with the given counts.
+struct SnapshotLayout {
+  size_t lines;
+  size_t x, y, prevX, prevY, invMass, flags;
+  size_t total;
+
+  SnapshotLayout(size_t headerSize, size_t lineCount, size_t n) {
+    lines = align16(headerSize);
+    x = align16(lines + lineCount * sizeof(SnapshotLine));
+    y = align16(x + n * sizeof(float));
+    prevX = align16(y + n * sizeof(float));
+    prevY = align16(prevX + n * sizeof(float));
+    invMass = align16(prevY + n * sizeof(float));
+    flags = align16(invMass + n * sizeof(float));
+    total = flags + n;
+  }
+};
+
+bool saveSnapshot(const Simulation &sim, const char *path) {
+    if constexpr (std::endian::native != std::endian::little) {
+        std::cerr << "Snapshots are only supported on little-endian hosts\n";
+        return false;
+    }
+
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.lineCount = static_cast<uint32_t>(sim.lines.size());
+    header.particleCount = static_cast<uint32_t>(sim.nodeCount());
+    header.gravity = sim.params.gravity;
+    header.timeStep = sim.params.timeStep;
+    header.damping = sim.params.damping;
+    header.radius = sim.params.radius;
+    header.width = sim.params.width;
+    header.height = sim.params.height;
+    header.iterations = sim.params.iterations;
+    header.substeps = sim.params.substeps;
+    header.solverMode = sim.params.solverMode;
+    header.sleepEnergy = sim.params.sleepEnergy;
+    header.sleepSteps = sim.params.sleepSteps;
+
+    std::vector<SnapshotLine> table;
+    table.reserve(sim.lines.size());
+    uint32_t packed = 0;
+    for (const Line *line : sim.lines) {
+        table.push_back({packed, static_cast<uint32_t>(line->size()), line->delta, line->compliance});
+        packed += line->size();
+    }
+
+    FILE *file = std::fopen(path, "wb");
+    if (!file) {
+        std::cerr << "Could not open " << path << " for writing\n";
+        return false;
+    }
+
+    const SnapshotLayout layout(sizeof(SnapshotHeader), header.lineCount, header.particleCount);
+    const ParticleStore &p = sim.particles;
+    size_t written = 0;
+    bool ok = true;
+    auto padTo = [&](size_t offset) {
+        static const char zeros[16] = {};
+        if (offset > written) ok &= std::fwrite(zeros, 1, offset - written, file) == offset - written;
+        written = offset;
+    };
+    auto put = [&](const void *data, size_t bytes) {
+        if (bytes == 0) return;
+        ok &= std::fwrite(data, 1, bytes, file) == bytes;
+        written += bytes;
+    };
+    // One contiguous write per line and column, never per node.
+    auto putColumn = [&](size_t offset, const auto &column) {
+        padTo(offset);
+        for (const Line *line : sim.lines) {
+            put(column.data() + line->first, line->size() * sizeof(column[0]));
+        }
+    };
+
+    put(&header, sizeof(header));
+    padTo(layout.lines);
+    put(table.data(), table.size() * sizeof(SnapshotLine));
+    putColumn(layout.x, p.x);
+    putColumn(layout.y, p.y);
+    putColumn(layout.prevX, p.prevX);
+    putColumn(layout.prevY, p.prevY);
+    putColumn(layout.invMass, p.invMass);
+    putColumn(layout.flags, p.flags);
+
+    ok &= std::fclose(file) == 0;
+    if (!ok) std::cerr << "Failed writing snapshot " << path << "\n";
+    return ok;
+}
+
+// Read-only view of the whole file: mmap where available.
+class MappedFile {
+public:
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+
+  explicit MappedFile(const char *path) {
+#if defined(_WIN32)
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return;
+    buffer.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
+    data = buffer.data();
+    size = buffer.size();
+#else
+    fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) return;
+    void *mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) return;
+    data = static_cast<const uint8_t *>(mapped);
+    size = static_cast<size_t>(st.st_size);
+#endif
+  }
+
+  ~MappedFile() {
+#if !defined(_WIN32)
+    if (data) munmap(const_cast<uint8_t *>(data), size);
+    if (fd >= 0) close(fd);
+#endif
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+private:
+#if defined(_WIN32)
+  std::vector<uint8_t> buffer;
+#else
+  int fd = -1;
+#endif
+};
+
+bool loadSnapshot(Simulation &sim, const char *path) {
+    if constexpr (std::endian::native != std::endian::little) {
+        std::cerr << "Snapshots are only supported on little-endian hosts\n";
+        return false;
+    }
+
+    MappedFile file(path);
+    if (!file.data) {
+        std::cerr << "Could not open snapshot " << path << "\n";
+        return false;
+    }
+    if (file.size < SNAPSHOT_V1_HEADER_SIZE) {
+        std::cerr << "Snapshot " << path << " is truncated\n";
+        return false;
+    }
+
+    // Older headers are a prefix of the current one.
+    SnapshotHeader header = {};
+    std::memcpy(&header, file.data, SNAPSHOT_V1_HEADER_SIZE);
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        std::cerr << path << " is not a snapshot\n";
+        return false;
+    }
+    const size_t headerSize = header.version >= 3 ? sizeof(SnapshotHeader) : SNAPSHOT_V1_HEADER_SIZE;
+    if (header.version < SNAPSHOT_MIN_VERSION || header.version > SNAPSHOT_VERSION ||
+        header.headerSize != headerSize) {
+        std::cerr << "Unsupported snapshot version " << header.version << "\n";
+        return false;
+    }
+    if (file.size < headerSize) {
+        std::cerr << "Snapshot " << path << " is truncated\n";
+        return false;
+    }
+    std::memcpy(&header, file.data, headerSize);
+    if (header.version >= 3 && (header.solverMode < 0 || header.solverMode >= SOLVER_MODE_COUNT)) {
+        std::cerr << "Snapshot " << path << " has an unknown solver mode\n";
+        return false;
+    }
+
+    // The step divides by timeStep and substeps and takes powers of damping;
+    // a NaN or zero here would poison every particle on the first step.
+    auto positive = [](float v) { return std::isfinite(v) && v > 0.0f; };
+    const bool paramsValid = std::isfinite(header.gravity) && positive(header.timeStep) && positive(header.radius) &&
+                             positive(header.width) && positive(header.height) && header.damping >= 0.0f &&
+                             header.damping <= 1.0f && header.iterations >= 0 && header.substeps >= 1 &&
+                             (header.version < 3 || (std::isfinite(header.sleepEnergy) && header.sleepEnergy >= 0.0f &&
+                                                     header.sleepSteps >= 0));
+    if (!paramsValid) {
+        std::cerr << "Snapshot " << path << " has invalid simulation parameters\n";
+        return false;
+    }
+
+    const size_t n = header.particleCount;
+    const SnapshotLayout layout(headerSize, header.lineCount, n);
+    if (file.size < layout.total) {
+        std::cerr << "Snapshot " << path << " is truncated\n";
+        return false;
+    }
+
+    // The ranges tile [0, n) exactly: no two share a node and no particle
+    // is left without a line to own (and later release) it.
+    const SnapshotLine *table = reinterpret_cast<const SnapshotLine *>(file.data + layout.lines);
+    std::vector<uint32_t> order(header.lineCount);
+    for (uint32_t l = 0; l < header.lineCount; ++l) order[l] = l;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return table[a].first < table[b].first; });
+    size_t covered = 0;
+    bool tiled = true;
+    for (uint32_t l : order) {
+        const size_t end = static_cast<size_t>(table[l].first) + table[l].count;
+        // A lone node has no link, so its rest length may be 0.
+        const bool restValid = std::isfinite(table[l].delta) &&
+                               (table[l].count > 1 ? table[l].delta > 0.0f : table[l].delta >= 0.0f) &&
+                               (header.version < 2 || (std::isfinite(table[l].compliance) && table[l].compliance >= 0.0f));
+        if (!restValid || end > n || (table[l].count > 0 && table[l].first != covered)) {
+            tiled = false;
+            break;
+        }
+        covered = std::max(covered, end);
+    }
+    if (!tiled || covered != n) {
+        std::cerr << "Snapshot " << path << " has an invalid line table\n";
+        return false;
+    }
+
+    // Pins and inverse masses must agree the way ParticleStore::setFixed
+    // keeps them: 0 for a fixed particle, positive for a free one.
+    const float *invMass = reinterpret_cast<const float *>(file.data + layout.invMass);
+    const uint8_t *flags = file.data + layout.flags;
+    for (size_t i = 0; i < n; ++i) {
+        const bool fixed = flags[i] & PARTICLE_FIXED;
+        const bool valid = (flags[i] & ~(PARTICLE_ALIVE | PARTICLE_FIXED)) == 0 && (flags[i] & PARTICLE_ALIVE) &&
+                           (fixed ? invMass[i] == 0.0f : std::isfinite(invMass[i]) && invMass[i] > 0.0f);
+        if (!valid) {
+            std::cerr << "Snapshot " << path << " has an invalid particle " << i << "\n";
+            return false;
+        }
+    }
+
+    sim.clear();
+    sim.particles.clear();
+    const int first = sim.particles.allocate(static_cast<int>(n));
+
+    ParticleStore &p = sim.particles;
+    auto getColumn = [&](size_t offset, auto &column) {
+        if (n == 0) return;
+        std::memcpy(column.data() + first, file.data + offset, n * sizeof(column[0]));
+    };
+    getColumn(layout.x, p.x);
+    getColumn(layout.y, p.y);
+    getColumn(layout.prevX, p.prevX);
+    getColumn(layout.prevY, p.prevY);
+    getColumn(layout.invMass, p.invMass);
+    getColumn(layout.flags, p.flags);
+
+    sim.lines.reserve(header.lineCount);
+    for (uint32_t l = 0; l < header.lineCount; ++l) {
+        Line *line = new Line(sim.particles);
+        line->first = first + static_cast<int>(table[l].first);
+        line->count = static_cast<int>(table[l].count);
+        line->capacity = line->count;
+        line->delta = table[l].delta;
+        line->compliance = header.version >= 2 ? table[l].compliance : 0.0f;
+        sim.lines.push_back(line);
+    }
+
+    sim.params.gravity = header.gravity;
+    sim.params.timeStep = header.timeStep;
+    sim.params.damping = header.damping;
+    sim.params.radius = header.radius;
+    sim.params.width = header.width;
+    sim.params.height = header.height;
+    sim.params.iterations = header.iterations;
+    sim.params.substeps = header.substeps;
+    if (header.version >= 3) {
+        sim.params.solverMode = static_cast<SolverMode>(header.solverMode);
+        sim.params.sleepEnergy = header.sleepEnergy;
+        sim.params.sleepSteps = header.sleepSteps;
+    }
+    sim.topologyChanged();
+    return true;
+}
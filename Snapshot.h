@@ -0,0 +1,77 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <cstdint>
+
+#include "Simulation.h"
+
+// Binary world snapshot, little-endian, version SNAPSHOT_VERSION:
+//
+//   SnapshotHeader                       (80 bytes)
+//   SnapshotLine[lineCount]              (16 bytes each)
+//   float x[n], y[n], prevX[n], prevY[n], invMass[n]
+//   uint8 flags[n]
+//
+// Every block starts on a 16-byte boundary and n = particleCount. Lines
+// are stored compacted, one after another, so a line's nodes are
+// [first, first + count) of each column. Loading maps the file and
+// memcpy's whole columns; there is no per-node parsing.
+//
+// Line ranges must tile [0, n) without overlapping: the parallel solver
+// passes rely on lines never sharing a node, and a particle outside every
+// line would never be released. Every particle must be alive, and its
+// inverse mass 0 exactly when it is fixed. Step params must be finite,
+// with positive time step, radius and box, damping in [0, 1] and at least
+// one substep; a linked line needs a positive rest length and no line may
+// have negative compliance. Other files are rejected before the
+// simulation is touched.
+//
+// Version 2 stores each line's compliance in what was a reserved word of
+// SnapshotLine; version 1 files still load, with every line rigid. Version 3
+// grows the header to 80 bytes for the solver mode and sleep settings;
+// older files leave those params as they were. The remaining solver
+// settings (tolerances, budget, attachments, default compliance) are
+// runtime options and are not saved.
+
+#define SNAPSHOT_MAGIC "VRLTSNAP"
+#define SNAPSHOT_VERSION 3
+#define SNAPSHOT_MIN_VERSION 1
+#define SNAPSHOT_V1_HEADER_SIZE 64
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t headerSize;
+  uint32_t lineCount;
+  uint32_t particleCount;
+  float gravity;
+  float timeStep;
+  float damping;
+  float radius;
+  float width;
+  float height;
+  int32_t iterations;
+  int32_t substeps;
+  uint8_t reserved[8];
+  // Version 3 on.
+  int32_t solverMode;
+  float sleepEnergy;
+  int32_t sleepSteps;
+  uint8_t reserved3[4];
+};
+static_assert(sizeof(SnapshotHeader) == 80, "snapshot header layout changed");
+
+struct SnapshotLine {
+  uint32_t first;
+  uint32_t count;
+  float delta;
+  float compliance;  // since version 2, reserved before
+};
+static_assert(sizeof(SnapshotLine) == 16, "snapshot line layout changed");
+
+// Both print the reason to stderr and return false on failure. A failed
+// load leaves the simulation untouched.
+bool saveSnapshot(const Simulation &sim, const char *path);
+bool loadSnapshot(Simulation &sim, const char *path);
+
+
+#endif //SNAPSHOT_H
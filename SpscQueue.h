@@ -0,0 +1,38 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for exactly one producer and one consumer
+// thread. Capacity must be a power of two; push() fails instead of
+// blocking when the queue is full.
+template <typename T, size_t Capacity>
+class SpscQueue {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+  bool push(const T &value) {
+    const size_t tail = tailIndex.load(std::memory_order_relaxed);
+    if (tail - headIndex.load(std::memory_order_acquire) == Capacity) return false;
+    items[tail & (Capacity - 1)] = value;
+    tailIndex.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &value) {
+    const size_t head = headIndex.load(std::memory_order_relaxed);
+    if (head == tailIndex.load(std::memory_order_acquire)) return false;
+    value = items[head & (Capacity - 1)];
+    headIndex.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  T items[Capacity];
+  // Producer and consumer indices on separate cache lines.
+  alignas(64) std::atomic<size_t> headIndex{0};
+  alignas(64) std::atomic<size_t> tailIndex{0};
+};
+
+
+#endif //SPSCQUEUE_H
@@ -0,0 +1,370 @@
+#include "TrajectoryRecorder.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(VERLET_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+#if !defined(_WIN32)
+#include <sys/types.h>
+#endif
+
+// fseek takes a long, which is 32 bits on Windows, so chunk offsets past
+// 2 GiB in a long recording would be truncated.
+static int seek(FILE *file, int64_t offset, int origin) {
+#if defined(_WIN32)
+    return _fseeki64(file, offset, origin);
+#else
+    if (static_cast<int64_t>(static_cast<off_t>(offset)) != offset) return -1;
+    return fseeko(file, static_cast<off_t>(offset), origin);
+#endif
+}
+
+static void putVarint(std::vector<uint8_t> &out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static void putSigned(std::vector<uint8_t> &out, int32_t value) {
+    putVarint(out, (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31));
+}
+
+// Returns false when the varint would run past `end`.
+static bool getVarint(const uint8_t *&in, const uint8_t *end, uint32_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (in == end) return false;
+        uint8_t byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+static bool getSigned(const uint8_t *&in, const uint8_t *end, int32_t &value) {
+    uint32_t zigzag;
+    if (!getVarint(in, end, zigzag)) return false;
+    value = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+    return true;
+}
+
+TrajectoryRecorder::TrajectoryRecorder(int every, int slots, float quantum, int framesPerChunk)
+    : every(std::max(every, 1)), quantum(quantum), framesPerChunk(std::max(framesPerChunk, 1)),
+      slots(std::max(slots, 1)) {
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+    close();
+}
+
+bool TrajectoryRecorder::open(const char *path) {
+    if constexpr (std::endian::native != std::endian::little) {
+        std::cerr << "Trajectories are only supported on little-endian hosts\n";
+        return false;
+    }
+    close();
+
+    file = std::fopen(path, "wb");
+    if (!file) {
+        std::cerr << "Could not open " << path << " for writing\n";
+        return false;
+    }
+
+    TrajectoryHeader header = {};
+    std::memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+    header.version = TRAJECTORY_VERSION;
+    header.headerSize = sizeof(TrajectoryHeader);
+    header.quantum = quantum;
+    header.every = static_cast<uint32_t>(every);
+    header.framesPerChunk = static_cast<uint32_t>(framesPerChunk);
+
+    fileOffset = 0;
+    writeFailed = false;
+    index.clear();
+    chunk.clear();
+    chunkFrames = 0;
+    framesEncoded = 0;
+    frameCounter = 0;
+    framesCaptured = 0;
+    framesWritten = 0;
+    framesDropped = 0;
+    bytesWritten = 0;
+    write(&header, sizeof(header));
+
+    freeSlots.clear();
+    readySlots.clear();
+    for (int s = 0; s < static_cast<int>(slots.size()); ++s) freeSlots.push_back(s);
+    stopping = false;
+    writer = std::thread(&TrajectoryRecorder::writerLoop, this);
+    return true;
+}
+
+void TrajectoryRecorder::close() {
+    if (!file) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+
+    // The writer has drained the queue; finish with the index and footer.
+    flushChunk();
+    TrajectoryFooter footer = {};
+    footer.indexOffset = fileOffset;
+    footer.chunkCount = static_cast<uint32_t>(index.size());
+    std::memcpy(footer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(footer.magic));
+    write(index.data(), index.size() * sizeof(TrajectoryChunk));
+    write(&footer, sizeof(footer));
+
+    if (std::fclose(file) != 0) writeFailed = true;
+    if (writeFailed) std::cerr << "Failed writing trajectory\n";
+    file = nullptr;
+}
+
+void TrajectoryRecorder::capture(const Simulation &sim) {
+    if (!file) return;
+    const long long frame = frameCounter++;
+    if (frame % every != 0) return;
+
+    int s;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeSlots.empty()) {
+            framesDropped++;
+            return;
+        }
+        s = freeSlots.back();
+        freeSlots.pop_back();
+    }
+
+    // The buffers keep their capacity between frames, so once warm this is
+    // a plain copy per line.
+    Slot &slot = slots[s];
+    const int n = sim.nodeCount();
+    slot.frame = static_cast<uint32_t>(frame);
+    slot.topology = sim.topologyRevision();
+    slot.x.resize(n);
+    slot.y.resize(n);
+    int packedIndex = 0;
+    for (const Line *line : sim.lines) {
+        std::copy_n(sim.particles.x.begin() + line->first, line->size(), slot.x.begin() + packedIndex);
+        std::copy_n(sim.particles.y.begin() + line->first, line->size(), slot.y.begin() + packedIndex);
+        packedIndex += line->size();
+    }
+    framesCaptured++;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        readySlots.push_back(s);
+    }
+    wake.notify_one();
+}
+
+RecorderStats TrajectoryRecorder::stats() const {
+    RecorderStats out;
+    out.framesCaptured = framesCaptured;
+    out.framesWritten = framesWritten;
+    out.framesDropped = framesDropped;
+    out.bytesWritten = bytesWritten;
+    return out;
+}
+
+void TrajectoryRecorder::writerLoop() {
+    for (;;) {
+        int s;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !readySlots.empty(); });
+            if (readySlots.empty()) return;  // stopping and drained
+            s = readySlots.front();
+            readySlots.pop_front();
+        }
+
+        encode(slots[s]);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeSlots.push_back(s);
+        }
+        if (chunkFrames == framesPerChunk) flushChunk();
+    }
+}
+
+void TrajectoryRecorder::encode(const Slot &slot) {
+    const int n = static_cast<int>(slot.x.size());
+    // Deltas are only meaningful against a frame with the same nodes; a
+    // topology change (even one that keeps the node count, like a cut or a
+    // delete and insert of the same size) starts a new chunk with absolute
+    // positions.
+    if (chunkFrames > 0 && (slot.topology != previousTopology || static_cast<int>(previous.size()) != 2 * n)) {
+        flushChunk();
+    }
+    const bool key = chunkFrames == 0;
+    previousTopology = slot.topology;
+
+    putVarint(chunk, slot.frame);
+    putVarint(chunk, static_cast<uint32_t>(n));
+    previous.resize(2 * n);
+    const float scale = 1.0f / quantum;
+    for (int i = 0; i < n; ++i) {
+        int32_t qx = static_cast<int32_t>(std::lround(slot.x[i] * scale));
+        int32_t qy = static_cast<int32_t>(std::lround(slot.y[i] * scale));
+        putSigned(chunk, key ? qx : qx - previous[2 * i]);
+        putSigned(chunk, key ? qy : qy - previous[2 * i + 1]);
+        previous[2 * i] = qx;
+        previous[2 * i + 1] = qy;
+    }
+    chunkFrames++;
+    framesWritten++;
+}
+
+void TrajectoryRecorder::flushChunk() {
+    if (chunkFrames == 0) return;
+
+    TrajectoryChunk entry = {};
+    entry.offset = fileOffset;
+    entry.rawSize = static_cast<uint32_t>(chunk.size());
+    entry.firstFrame = framesEncoded;
+    entry.frameCount = static_cast<uint32_t>(chunkFrames);
+
+    const uint8_t *data = chunk.data();
+    size_t size = chunk.size();
+#if defined(VERLET_HAVE_ZLIB)
+    uLongf packedSize = compressBound(static_cast<uLong>(chunk.size()));
+    packed.resize(packedSize);
+    if (compress2(packed.data(), &packedSize, chunk.data(), static_cast<uLong>(chunk.size()),
+                  Z_BEST_SPEED) == Z_OK && packedSize < chunk.size()) {
+        data = packed.data();
+        size = packedSize;
+    }
+#endif
+    entry.storedSize = static_cast<uint32_t>(size);
+    write(data, size);
+    index.push_back(entry);
+
+    framesEncoded += entry.frameCount;
+    chunkFrames = 0;
+    chunk.clear();
+}
+
+void TrajectoryRecorder::write(const void *data, size_t size) {
+    if (size == 0) return;
+    if (std::fwrite(data, 1, size, file) != size) writeFailed = true;
+    fileOffset += size;
+    bytesWritten += static_cast<long long>(size);
+}
+
+bool TrajectoryReader::open(const char *path) {
+    close();
+    file = std::fopen(path, "rb");
+    if (!file) {
+        std::cerr << "Could not open trajectory " << path << "\n";
+        return false;
+    }
+
+    TrajectoryFooter footer;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              seek(file, -static_cast<int64_t>(sizeof(footer)), SEEK_END) == 0 &&
+              std::fread(&footer, sizeof(footer), 1, file) == 1;
+    if (!ok || std::memcmp(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic)) != 0 ||
+        std::memcmp(footer.magic, TRAJECTORY_INDEX_MAGIC, sizeof(footer.magic)) != 0) {
+        std::cerr << path << " is not a complete trajectory\n";
+        close();
+        return false;
+    }
+    if (header.version != TRAJECTORY_VERSION || header.headerSize != sizeof(TrajectoryHeader)) {
+        std::cerr << "Unsupported trajectory version " << header.version << "\n";
+        close();
+        return false;
+    }
+
+    index.resize(footer.chunkCount);
+    if (seek(file, static_cast<int64_t>(footer.indexOffset), SEEK_SET) != 0 ||
+        std::fread(index.data(), sizeof(TrajectoryChunk), index.size(), file) != index.size()) {
+        std::cerr << "Trajectory " << path << " has a truncated index\n";
+        close();
+        return false;
+    }
+    totalFrames = index.empty() ? 0 : static_cast<int>(index.back().firstFrame + index.back().frameCount);
+    return true;
+}
+
+void TrajectoryReader::close() {
+    if (file) std::fclose(file);
+    file = nullptr;
+    index.clear();
+    totalFrames = 0;
+    cachedChunk = -1;
+}
+
+bool TrajectoryReader::loadChunk(int c) {
+    if (c == cachedChunk) return true;
+    const TrajectoryChunk &entry = index[c];
+    stored.resize(entry.storedSize);
+    if (seek(file, static_cast<int64_t>(entry.offset), SEEK_SET) != 0 ||
+        std::fread(stored.data(), 1, stored.size(), file) != stored.size()) {
+        return false;
+    }
+    if (entry.storedSize == entry.rawSize) {
+        raw.swap(stored);
+    } else {
+#if defined(VERLET_HAVE_ZLIB)
+        raw.resize(entry.rawSize);
+        uLongf rawSize = entry.rawSize;
+        if (uncompress(raw.data(), &rawSize, stored.data(), entry.storedSize) != Z_OK ||
+            rawSize != entry.rawSize) {
+            return false;
+        }
+#else
+        std::cerr << "Trajectory chunk is compressed but zlib support is not built in\n";
+        return false;
+#endif
+    }
+    cachedChunk = c;
+    return true;
+}
+
+long long TrajectoryReader::readFrame(int ordinal, std::vector<float> &x, std::vector<float> &y) {
+    if (!file || ordinal < 0 || ordinal >= totalFrames) return -1;
+
+    auto it = std::upper_bound(index.begin(), index.end(), static_cast<uint32_t>(ordinal),
+                               [](uint32_t value, const TrajectoryChunk &c) { return value < c.firstFrame; });
+    const int c = static_cast<int>(it - index.begin()) - 1;
+    if (!loadChunk(c)) {
+        cachedChunk = -1;
+        return -1;
+    }
+
+    // Replay the chunk's deltas up to the requested frame.
+    const uint8_t *in = raw.data();
+    const uint8_t *end = in + raw.size();
+    std::vector<int32_t> q;
+    uint32_t frame = 0;
+    for (uint32_t f = index[c].firstFrame; f <= static_cast<uint32_t>(ordinal); ++f) {
+        uint32_t n;
+        if (!getVarint(in, end, frame) || !getVarint(in, end, n)) return -1;
+        if (f == index[c].firstFrame) q.assign(2 * static_cast<size_t>(n), 0);
+        else if (q.size() != 2 * static_cast<size_t>(n)) return -1;
+        for (int32_t &value : q) {
+            int32_t d;
+            if (!getSigned(in, end, d)) return -1;
+            value += d;
+        }
+    }
+
+    const size_t n = q.size() / 2;
+    x.resize(n);
+    y.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        x[i] = static_cast<float>(q[2 * i]) * header.quantum;
+        y[i] = static_cast<float>(q[2 * i + 1]) * header.quantum;
+    }
+    return frame;
+}
@@ -0,0 +1,164 @@
+#ifndef TRAJECTORYRECORDER_H
+#define TRAJECTORYRECORDER_H
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Simulation.h"
+
+// Trajectory file, little-endian, version TRAJECTORY_VERSION:
+//
+//   TrajectoryHeader                     (32 bytes)
+//   chunk bytes ...                      (one block per TrajectoryChunk)
+//   TrajectoryChunk[chunkCount]          (the seek index, 24 bytes each)
+//   TrajectoryFooter                     (24 bytes, always last)
+//
+// A chunk holds up to framesPerChunk frames. Its first frame stores
+// absolute positions, the rest store the change since the previous frame;
+// positions are quantised to multiples of `quantum` and every value is a
+// zigzag LEB128 varint. Chunks are deflated when built with zlib (a chunk
+// whose storedSize equals rawSize is stored as-is). Nodes are written in
+// line order, as in a snapshot.
+//
+// Per frame: varint frame number, varint node count, then 2 * count
+// varints (x0, y0, x1, y1, ...).
+
+#define TRAJECTORY_MAGIC "VRLTTRAJ"
+#define TRAJECTORY_INDEX_MAGIC "VRLTTIDX"
+#define TRAJECTORY_VERSION 1
+
+struct TrajectoryHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t headerSize;
+  float quantum;
+  uint32_t every;
+  uint32_t framesPerChunk;
+  uint32_t reserved;
+};
+static_assert(sizeof(TrajectoryHeader) == 32, "trajectory header layout changed");
+
+struct TrajectoryChunk {
+  uint64_t offset;
+  uint32_t storedSize;
+  uint32_t rawSize;
+  uint32_t firstFrame;  // ordinal of the chunk's first recorded frame
+  uint32_t frameCount;
+};
+static_assert(sizeof(TrajectoryChunk) == 24, "trajectory chunk layout changed");
+
+struct TrajectoryFooter {
+  uint64_t indexOffset;
+  uint32_t chunkCount;
+  uint32_t reserved;
+  char magic[8];
+};
+static_assert(sizeof(TrajectoryFooter) == 24, "trajectory footer layout changed");
+
+struct RecorderStats {
+  long long framesCaptured = 0;
+  long long framesWritten = 0;
+  long long framesDropped = 0;
+  long long bytesWritten = 0;
+};
+
+// Records every `every`-th frame of node positions without stalling the
+// caller: capture() copies positions into one of `slots` preallocated
+// buffers and a writer thread encodes and appends them. When every buffer
+// is still queued the frame is dropped instead of waiting.
+class TrajectoryRecorder {
+public:
+  explicit TrajectoryRecorder(int every = 1, int slots = 4, float quantum = 1.0f / 64.0f,
+                              int framesPerChunk = 64);
+  ~TrajectoryRecorder();
+
+  TrajectoryRecorder(const TrajectoryRecorder &) = delete;
+  TrajectoryRecorder &operator=(const TrajectoryRecorder &) = delete;
+
+  // Starts the writer thread. Prints the reason to stderr on failure.
+  bool open(const char *path);
+  // Writes out everything queued, then the index, and joins the writer.
+  void close();
+  bool recording() const { return file != nullptr; }
+
+  void capture(const Simulation &sim);
+
+  RecorderStats stats() const;
+
+private:
+  struct Slot {
+    uint32_t frame = 0;
+    uint64_t topology = 0;  // Simulation::topologyRevision() when captured
+    std::vector<float> x;
+    std::vector<float> y;
+  };
+
+  int every;
+  float quantum;
+  int framesPerChunk;
+  long long frameCounter = 0;
+
+  std::vector<Slot> slots;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::vector<int> freeSlots;
+  std::deque<int> readySlots;
+  bool stopping = false;
+  std::thread writer;
+  FILE *file = nullptr;
+
+  // Writer thread state.
+  std::vector<uint8_t> chunk;
+  std::vector<uint8_t> packed;
+  std::vector<int32_t> previous;
+  uint64_t previousTopology = 0;
+  int chunkFrames = 0;
+  uint32_t framesEncoded = 0;
+  std::vector<TrajectoryChunk> index;
+  uint64_t fileOffset = 0;
+  bool writeFailed = false;
+
+  std::atomic<long long> framesCaptured{0};
+  std::atomic<long long> framesWritten{0};
+  std::atomic<long long> framesDropped{0};
+  std::atomic<long long> bytesWritten{0};
+
+  void writerLoop();
+  void encode(const Slot &slot);
+  void flushChunk();
+  void write(const void *data, size_t size);
+};
+
+// Random access to a recorded trajectory through its chunk index.
+class TrajectoryReader {
+public:
+  ~TrajectoryReader() { close(); }
+
+  bool open(const char *path);
+  void close();
+
+  int frameCount() const { return totalFrames; }
+  int chunkCount() const { return static_cast<int>(index.size()); }
+  // Decodes recorded frame `ordinal` (0-based) into x/y and returns its
+  // simulation frame number, or -1 on error.
+  long long readFrame(int ordinal, std::vector<float> &x, std::vector<float> &y);
+
+private:
+  FILE *file = nullptr;
+  TrajectoryHeader header = {};
+  std::vector<TrajectoryChunk> index;
+  int totalFrames = 0;
+  int cachedChunk = -1;
+  std::vector<uint8_t> stored;
+  std::vector<uint8_t> raw;
+
+  bool loadChunk(int c);
+};
+
+
+#endif //TRAJECTORYRECORDER_H
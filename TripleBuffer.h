@@ -0,0 +1,42 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-writer / single-reader triple buffer. The writer fills
+// back() and publish()es it; the reader refresh()es to pick up the newest
+// published value and reads front(). Neither side ever waits: the three
+// slots are exchanged through one atomic index, so the reader always holds
+// a complete value and the writer never overwrites it. Unread values are
+// simply replaced by newer ones.
+template <typename T>
+class TripleBuffer {
+public:
+  // Writer side.
+  T &back() { return slots[backIndex]; }
+  void publish() {
+    uint8_t previous = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel);
+    backIndex = previous & INDEX_MASK;
+  }
+
+  // Reader side. Returns true if front() changed.
+  bool refresh() {
+    if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+    uint8_t previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+    frontIndex = previous & INDEX_MASK;
+    return true;
+  }
+  const T &front() const { return slots[frontIndex]; }
+
+private:
+  static constexpr uint8_t INDEX_MASK = 3;
+  static constexpr uint8_t FRESH = 4;  // middle holds a value the reader hasn't taken
+
+  T slots[3];
+  std::atomic<uint8_t> middle{1};
+  uint8_t frontIndex = 0;  // reader-owned
+  uint8_t backIndex = 2;   // writer-owned
+};
+
+
+#endif //TRIPLEBUFFER_H
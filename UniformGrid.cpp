@@ -0,0 +1,151 @@
+#include "UniformGrid.h"
+#include <algorithm>
+#include <cmath>
+
+UniformGrid::UniformGrid(float cellSize)
+    : minCellSize(cellSize) {
+}
+
+int UniformGrid::cellOf(float x, float y) const {
+    int cx = static_cast<int>((x - originX) / cellSize);
+    int cy = static_cast<int>((y - originY) / cellSize);
+    cx = std::clamp(cx, 0, cols - 1);
+    cy = std::clamp(cy, 0, rows - 1);
+    return cy * cols + cx;
+}
+
+void UniformGrid::build(const ParticleStore &store, const SceneIndex &index,
+                        const uint8_t *lineActive) {
+    lastStats = BroadPhaseStats();
+
+    // What the all-pairs loops would have tested only changes with topology.
+    if (index.version() != pairsVersion) {
+        long long total = 0;
+        long long sumSquares = 0;
+        bruteForcePairs = 0;
+        for (int l = 0; l < index.lineCount(); ++l) {
+            long long n = index.lineOffset[l + 1] - index.lineOffset[l];
+            total += n;
+            sumSquares += n * n;
+            if (n > 2) bruteForcePairs += (n - 1) * (n - 2) / 2;
+        }
+        bruteForcePairs += (total * total - sumSquares) / 2;
+        pairsVersion = index.version();
+    }
+    lastStats.bruteForcePairs = bruteForcePairs;
+
+    const std::vector<int> &particleIdx = index.nodes;
+    const std::vector<int> &particleLine = index.nodeLine;
+    const int count = static_cast<int>(particleIdx.size());
+    if (count == 0) {
+        cols = rows = 0;
+        cellStart.assign(1, 0);
+        entries.clear();
+        entryLine.clear();
+        entryActive.clear();
+        cellActive.clear();
+        return;
+    }
+
+    float minX = INFINITY, minY = INFINITY;
+    float maxX = -INFINITY, maxY = -INFINITY;
+    for (int i : particleIdx) {
+        minX = std::min(minX, store.x[i]);
+        minY = std::min(minY, store.y[i]);
+        maxX = std::max(maxX, store.x[i]);
+        maxY = std::max(maxY, store.y[i]);
+    }
+
+    // Keep the cell array proportional to the node count: a rope flung far
+    // away widens the cells instead of allocating a huge sparse grid.
+    float width = maxX - minX;
+    float height = maxY - minY;
+    const double maxCells = std::max(1024.0, 4.0 * count);
+    cellSize = minCellSize;
+    double needed = (std::floor(width / cellSize) + 1.0) * (std::floor(height / cellSize) + 1.0);
+    if (needed > maxCells) {
+        cellSize *= static_cast<float>(std::sqrt(needed / maxCells)) * 1.01f;
+    }
+    originX = minX;
+    originY = minY;
+    cols = static_cast<int>(width / cellSize) + 1;
+    rows = static_cast<int>(height / cellSize) + 1;
+
+    // Counting sort of the particles by cell.
+    const int cellCount = cols * rows;
+    cellStart.assign(cellCount + 1, 0);
+    particleCell.resize(count);
+    for (int k = 0; k < count; ++k) {
+        int i = particleIdx[k];
+        int c = cellOf(store.x[i], store.y[i]);
+        particleCell[k] = c;
+        cellStart[c + 1]++;
+    }
+    for (int c = 0; c < cellCount; ++c) {
+        cellStart[c + 1] += cellStart[c];
+    }
+
+    entries.resize(count);
+    entryLine.resize(count);
+    entryActive.resize(count);
+    cellActive.assign(cellCount, 0);
+    std::vector<int> &cursor = particleCell;  // reuse: becomes the write slot
+    for (int k = 0; k < count; ++k) {
+        int slot = cellStart[cursor[k]]++;
+        uint8_t active = lineActive ? lineActive[particleLine[k]] : 1;
+        entries[slot] = particleIdx[k];
+        entryLine[slot] = particleLine[k];
+        entryActive[slot] = active;
+        cellActive[cursor[k]] |= active;
+    }
+    // The fill pass advanced every start to the next cell's start; shift back.
+    for (int c = cellCount; c > 0; --c) {
+        cellStart[c] = cellStart[c - 1];
+    }
+    cellStart[0] = 0;
+}
+
+void UniformGrid::emitPairs(int cellA, int cellB, std::vector<CollisionPair> &intra,
+                            std::vector<CollisionPair> &inter) {
+    const bool same = cellA == cellB;
+    if (!cellActive[cellA] && !cellActive[cellB]) return;
+    for (int s = cellStart[cellA]; s < cellStart[cellA + 1]; ++s) {
+        int a = entries[s];
+        int lineA = entryLine[s];
+        bool activeA = entryActive[s];
+        int t = same ? s + 1 : cellStart[cellB];
+        for (; t < cellStart[cellB + 1]; ++t) {
+            if (!activeA && !entryActive[t]) continue;
+            int b = entries[t];
+            // Neighbouring nodes of the same rope are held apart by the distance constraint.
+            if (entryLine[t] == lineA) {
+                if (b - a == 1 || a - b == 1) continue;
+                intra.push_back({std::min(a, b), std::max(a, b)});
+            } else {
+                inter.push_back({std::min(a, b), std::max(a, b)});
+            }
+        }
+    }
+}
+
+void UniformGrid::findPairs(std::vector<CollisionPair> &intra, std::vector<CollisionPair> &inter) {
+    intra.clear();
+    inter.clear();
+    for (int cy = 0; cy < rows; ++cy) {
+        for (int cx = 0; cx < cols; ++cx) {
+            int c = cy * cols + cx;
+            if (cellStart[c] == cellStart[c + 1]) continue;
+
+            // Half stencil so each neighbouring cell pair is visited once.
+            emitPairs(c, c, intra, inter);
+            if (cx + 1 < cols) emitPairs(c, c + 1, intra, inter);
+            if (cy + 1 < rows) {
+                emitPairs(c, c + cols, intra, inter);
+                if (cx + 1 < cols) emitPairs(c, c + cols + 1, intra, inter);
+                if (cx > 0) emitPairs(c, c + cols - 1, intra, inter);
+            }
+        }
+    }
+    lastStats.intraLinePairs = static_cast<long long>(intra.size());
+    lastStats.candidatePairs = static_cast<long long>(intra.size() + inter.size());
+}
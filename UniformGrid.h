@@ -0,0 +1,66 @@
+#ifndef UNIFORMGRID_H
+#define UNIFORMGRID_H
+#include <cstdint>
+#include <vector>
+
+#include "SceneIndex.h"
+
+struct CollisionPair {
+  int a;
+  int b;
+};
+
+struct BroadPhaseStats {
+  long long candidatePairs = 0;   // pairs handed to the narrow phase
+  long long intraLinePairs = 0;   // ... of which both nodes are on the same line
+  long long bruteForcePairs = 0;  // pairs the all-pairs loops would have tested
+  long long skippedPairs() const { return bruteForcePairs - candidatePairs; }
+};
+
+// Uniform grid broad phase over every node of every line. Rebuilt each
+// step with a counting sort, then emits each pair of nodes from the same
+// or neighbouring cells once. Pairs of consecutive nodes of the same line
+// are skipped, matching the old intra-line `j >= i + 2` rule.
+//
+// Optionally each line can be marked inactive (sleeping): its nodes stay in
+// the grid, but pairs with no active node are never emitted and cells with
+// no active node are not scanned.
+class UniformGrid {
+public:
+  explicit UniformGrid(float cellSize);
+
+  void setCellSize(float size) { minCellSize = size; }
+  // lineActive, if given, has one flag per SceneIndex line.
+  void build(const ParticleStore &store, const SceneIndex &index,
+             const uint8_t *lineActive = nullptr);
+  // Candidate pairs split by whether both nodes belong to the same line.
+  void findPairs(std::vector<CollisionPair> &intra, std::vector<CollisionPair> &inter);
+
+  const BroadPhaseStats &stats() const { return lastStats; }
+
+private:
+  float minCellSize;
+  float cellSize = 0.0f;
+  float originX = 0.0f;
+  float originY = 0.0f;
+  int cols = 0;
+  int rows = 0;
+
+  std::vector<int> cellStart;     // cols * rows + 1 offsets into entries
+  std::vector<int> entries;       // particle indices sorted by cell
+  std::vector<int> entryLine;     // owning line of each sorted entry
+  std::vector<uint8_t> entryActive;
+  std::vector<uint8_t> cellActive;  // cell holds at least one active entry
+  std::vector<int> particleCell;  // cell of each SceneIndex entry
+  long long bruteForcePairs = 0;
+  unsigned pairsVersion = ~0u;    // SceneIndex version bruteForcePairs was counted for
+
+  BroadPhaseStats lastStats;
+
+  int cellOf(float x, float y) const;
+  void emitPairs(int cellA, int cellB, std::vector<CollisionPair> &intra,
+                 std::vector<CollisionPair> &inter);
+};
+
+
+#endif //UNIFORMGRID_H
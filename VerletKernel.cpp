@@ -0,0 +1,162 @@
+#include "VerletKernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VERLET_HAVE_AVX2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define VERLET_HAVE_NEON 1
+#endif
+
+// Scalar body shared by the fallback and the SIMD remainders.
+static inline void integrateOne(float *x, float *y, float *prevX, float *prevY,
+                                const float *invMass, const float *accX, const float *accY,
+                                int i, const IntegrateParams &params, float dt2) {
+    if (invMass && invMass[i] == 0.0f) return;
+
+    float ax = accX ? accX[i] : params.ax;
+    float ay = accY ? accY[i] : params.ay;
+    float cx = x[i];
+    float cy = y[i];
+
+    x[i] = cx + (cx - prevX[i]) * params.damping + ax * dt2;
+    y[i] = cy + (cy - prevY[i]) * params.damping + ay * dt2;
+    prevX[i] = cx;
+    prevY[i] = cy;
+}
+
+void integrateVerletScalar(float *x, float *y, float *prevX, float *prevY,
+                           const float *invMass, const float *accX, const float *accY,
+                           int count, const IntegrateParams &params) {
+    const float dt2 = params.dt * params.dt;
+    for (int i = 0; i < count; ++i) {
+        integrateOne(x, y, prevX, prevY, invMass, accX, accY, i, params, dt2);
+    }
+}
+
+#ifdef VERLET_HAVE_AVX2
+__attribute__((target("avx2")))
+static void integrateVerletAVX2(float *x, float *y, float *prevX, float *prevY,
+                                const float *invMass, const float *accX, const float *accY,
+                                int count, const IntegrateParams &params) {
+    const float dt2 = params.dt * params.dt;
+    const __m256 damping = _mm256_set1_ps(params.damping);
+    const __m256 dt2v = _mm256_set1_ps(dt2);
+    const __m256 uniformAx = _mm256_set1_ps(params.ax);
+    const __m256 uniformAy = _mm256_set1_ps(params.ay);
+    const __m256 zero = _mm256_setzero_ps();
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 cx = _mm256_loadu_ps(x + i);
+        __m256 cy = _mm256_loadu_ps(y + i);
+        __m256 px = _mm256_loadu_ps(prevX + i);
+        __m256 py = _mm256_loadu_ps(prevY + i);
+        __m256 ax = accX ? _mm256_loadu_ps(accX + i) : uniformAx;
+        __m256 ay = accY ? _mm256_loadu_ps(accY + i) : uniformAy;
+
+        __m256 nx = _mm256_add_ps(_mm256_add_ps(cx, _mm256_mul_ps(_mm256_sub_ps(cx, px), damping)),
+                                  _mm256_mul_ps(ax, dt2v));
+        __m256 ny = _mm256_add_ps(_mm256_add_ps(cy, _mm256_mul_ps(_mm256_sub_ps(cy, py), damping)),
+                                  _mm256_mul_ps(ay, dt2v));
+        __m256 npx = cx;
+        __m256 npy = cy;
+
+        if (invMass) {
+            // Lanes with zero inverse mass (fixed nodes) keep their old state.
+            __m256 movable = _mm256_cmp_ps(_mm256_loadu_ps(invMass + i), zero, _CMP_NEQ_OQ);
+            nx = _mm256_blendv_ps(cx, nx, movable);
+            ny = _mm256_blendv_ps(cy, ny, movable);
+            npx = _mm256_blendv_ps(px, npx, movable);
+            npy = _mm256_blendv_ps(py, npy, movable);
+        }
+
+        _mm256_storeu_ps(x + i, nx);
+        _mm256_storeu_ps(y + i, ny);
+        _mm256_storeu_ps(prevX + i, npx);
+        _mm256_storeu_ps(prevY + i, npy);
+    }
+    for (; i < count; ++i) {
+        integrateOne(x, y, prevX, prevY, invMass, accX, accY, i, params, dt2);
+    }
+}
+#endif
+
+#ifdef VERLET_HAVE_NEON
+static void integrateVerletNEON(float *x, float *y, float *prevX, float *prevY,
+                                const float *invMass, const float *accX, const float *accY,
+                                int count, const IntegrateParams &params) {
+    const float dt2 = params.dt * params.dt;
+    const float32x4_t damping = vdupq_n_f32(params.damping);
+    const float32x4_t dt2v = vdupq_n_f32(dt2);
+    const float32x4_t uniformAx = vdupq_n_f32(params.ax);
+    const float32x4_t uniformAy = vdupq_n_f32(params.ay);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t cx = vld1q_f32(x + i);
+        float32x4_t cy = vld1q_f32(y + i);
+        float32x4_t px = vld1q_f32(prevX + i);
+        float32x4_t py = vld1q_f32(prevY + i);
+        float32x4_t ax = accX ? vld1q_f32(accX + i) : uniformAx;
+        float32x4_t ay = accY ? vld1q_f32(accY + i) : uniformAy;
+
+        float32x4_t nx = vaddq_f32(vaddq_f32(cx, vmulq_f32(vsubq_f32(cx, px), damping)), vmulq_f32(ax, dt2v));
+        float32x4_t ny = vaddq_f32(vaddq_f32(cy, vmulq_f32(vsubq_f32(cy, py), damping)), vmulq_f32(ay, dt2v));
+        float32x4_t npx = cx;
+        float32x4_t npy = cy;
+
+        if (invMass) {
+            uint32x4_t fixed = vceqq_f32(vld1q_f32(invMass + i), zero);
+            nx = vbslq_f32(fixed, cx, nx);
+            ny = vbslq_f32(fixed, cy, ny);
+            npx = vbslq_f32(fixed, px, npx);
+            npy = vbslq_f32(fixed, py, npy);
+        }
+
+        vst1q_f32(x + i, nx);
+        vst1q_f32(y + i, ny);
+        vst1q_f32(prevX + i, npx);
+        vst1q_f32(prevY + i, npy);
+    }
+    for (; i < count; ++i) {
+        integrateOne(x, y, prevX, prevY, invMass, accX, accY, i, params, dt2);
+    }
+}
+#endif
+
+typedef void (*IntegrateFn)(float *, float *, float *, float *,
+                            const float *, const float *, const float *,
+                            int, const IntegrateParams &);
+
+struct KernelChoice {
+  IntegrateFn fn;
+  const char *name;
+};
+
+static KernelChoice selectKernel() {
+#ifdef VERLET_HAVE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {integrateVerletAVX2, "avx2"};
+#endif
+#ifdef VERLET_HAVE_NEON
+    return {integrateVerletNEON, "neon"};
+#endif
+    return {integrateVerletScalar, "scalar"};
+}
+
+static const KernelChoice &kernel() {
+    static const KernelChoice choice = selectKernel();
+    return choice;
+}
+
+void integrateVerlet(float *x, float *y, float *prevX, float *prevY,
+                     const float *invMass, const float *accX, const float *accY,
+                     int count, const IntegrateParams &params) {
+    kernel().fn(x, y, prevX, prevY, invMass, accX, accY, count, params);
+}
+
+const char *integrateKernelName() {
+    return kernel().name;
+}
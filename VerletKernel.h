@@ -0,0 +1,29 @@
+#ifndef VERLETKERNEL_H
+#define VERLETKERNEL_H
+
+struct IntegrateParams {
+  float damping = 1.0f;
+  float ax = 0.0f;   // uniform acceleration, used when no per-particle array is given
+  float ay = 0.0f;
+  float dt = 1.0f;
+};
+
+// Position Verlet over a contiguous SoA range:
+//   next = pos + (pos - prev) * damping + acc * dt^2,  prev = pos
+// Particles whose invMass is 0 are left untouched. invMass, accX and accY
+// may be null (everything moves / uniform acceleration).
+// Dispatches to an 8-lane AVX2 kernel when the CPU supports it, a 4-lane
+// NEON kernel on AArch64, and a scalar loop otherwise.
+void integrateVerlet(float *x, float *y, float *prevX, float *prevY,
+                     const float *invMass, const float *accX, const float *accY,
+                     int count, const IntegrateParams &params);
+
+void integrateVerletScalar(float *x, float *y, float *prevX, float *prevY,
+                           const float *invMass, const float *accX, const float *accY,
+                           int count, const IntegrateParams &params);
+
+// Name of the kernel picked at startup ("avx2", "neon" or "scalar").
+const char *integrateKernelName();
+
+
+#endif //VERLETKERNEL_H
@@ -1,13 +1,23 @@
 #include <cstdio>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <random>
+#include <vector>
+
+#include "BallCollider.h"
+#include "JobSystem.h"
+#include "VerletKernel.h"
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
-#define nBALLS 500
-#define QUALITY 10 // vertex count (circle points)
+// The world is WINDOW_WIDTH x WINDOW_HEIGHT scaled up (see ballBoxScale)
+// until the balls fill half of it, so any count can settle; 100k radius
+// 1..MAXRADIUS balls need about 3x the window in each direction.
+#define nBALLS 100000
+#define COLLISION_ITERATIONS 4
 #define deltaTime 1.5e-2
 
 #define RANDCONST 10
@@ -15,92 +25,79 @@
 #define G -9.8f
 #define maxABSAcceleration 10.0f
 
-// Vertex shader
+// Vertex shader: one point sprite per ball, sized to its diameter
 const char* vertexShaderSrc = R"(
 #version 330 core
-layout(location = 0) in vec2 aPos;
-layout(location = 1) in vec3 aColor;
+layout(location = 0) in float aX;
+layout(location = 1) in float aY;
+layout(location = 2) in float aRadius;
+layout(location = 3) in vec3 aColor;
+
+uniform float uPixelScale; // framebuffer pixels per world unit
+uniform vec2 uWorldSize;
 
 out vec3 vColor;
 
 void main() {
-    float x = (aPos.x / 400) - 1.0;
-    float y = 1.0 - (aPos.y / 300);
+    float x = 2.0 * aX / uWorldSize.x - 1.0;
+    float y = 1.0 - 2.0 * aY / uWorldSize.y;
     gl_Position = vec4(x, y, 0.0, 1.0);
+    gl_PointSize = 2.0 * aRadius * uPixelScale;
     vColor = aColor;
 }
 )";
 
-// Fragment shader
+// Fragment shader: cut the square sprite down to a disc
 const char* fragmentShaderSrc = R"(
 #version 330 core
 in vec3 vColor;
 out vec4 FragColor;
 
 void main() {
+    vec2 d = gl_PointCoord * 2.0 - 1.0;
+    if (dot(d, d) > 1.0) discard;
     FragColor = vec4(vColor, 1.0);
 }
 )";
 
-
-void precomputeCircle(float shapeVerts[], int quality) {
-    float angleStep = 2.0f * M_PI / quality;
-    for (int i = 0; i < quality; ++i) {
-        shapeVerts[i * 2 + 0] = cosf(i * angleStep);
-        shapeVerts[i * 2 + 1] = sinf(i * angleStep);
-    }
-}
-
-void updateBallVertices(float* outVerts, float cx, float cy, float radius, float* shapeVerts, int quality) {
-    outVerts[0] = cx;
-    outVerts[1] = cy;
-    for (int i = 0; i < quality; ++i) {
-        outVerts[(i + 1) * 2 + 0] = cx + radius * shapeVerts[i * 2];
-        outVerts[(i + 1) * 2 + 1] = cy + radius * shapeVerts[i * 2 + 1];
-    }
-    // Close fan by repeating first perimeter vertex
-    outVerts[(quality + 1) * 2 + 0] = outVerts[2];
-    outVerts[(quality + 1) * 2 + 1] = outVerts[3];
-}
-
-void handleBoundaryCollision(float* prevPos, float* pos, int index, int radius) {
+void handleBoundaryCollision(float* prevX, float* prevY, float* x, float* y, int i, int radius,
+                             float width, float height) {
     // Left boundary
-    if (pos[index] < radius) {
-        pos[index] = (float)radius;
-        prevPos[index] = pos[index] + (pos[index] - prevPos[index]); // reflect velocity x
+    if (x[i] < radius) {
+        x[i] = (float)radius;
+        prevX[i] = x[i] + (x[i] - prevX[i]); // reflect velocity x
     }
     // Right boundary
-    else if (pos[index] > WINDOW_WIDTH - radius) {
-        pos[index] = WINDOW_WIDTH - radius;
-        prevPos[index] = pos[index] + (pos[index] - prevPos[index]); // reflect velocity x
+    else if (x[i] > width - radius) {
+        x[i] = width - radius;
+        prevX[i] = x[i] + (x[i] - prevX[i]); // reflect velocity x
     }
 
     // Top boundary
-    if (pos[index + 1] < radius) {
-        pos[index + 1] = (float)radius;
-        prevPos[index + 1] = pos[index + 1] + (pos[index + 1] - prevPos[index + 1]); // reflect velocity y
+    if (y[i] < radius) {
+        y[i] = (float)radius;
+        prevY[i] = y[i] + (y[i] - prevY[i]); // reflect velocity y
     }
     // Bottom boundary
-    else if (pos[index + 1] > WINDOW_HEIGHT - radius) {
-        pos[index + 1] = WINDOW_HEIGHT - radius;
-        prevPos[index + 1] = pos[index + 1] + (pos[index + 1] - prevPos[index + 1]); // reflect velocity y
+    else if (y[i] > height - radius) {
+        y[i] = height - radius;
+        prevY[i] = y[i] + (y[i] - prevY[i]); // reflect velocity y
     }
 }
 
-void verlet(float* prevPos, float* pos, float* acc, int* radius, int nBalls, float dt = 1.0f) {
-    for (int i = 0; i < nBalls; i++) {
-        int index = i * 2;
-
-        float nextX = pos[index] + (pos[index] - prevPos[index]) + acc[index] * dt * dt;
-        float nextY = pos[index + 1] + (pos[index + 1] - prevPos[index + 1]) + acc[index + 1] * dt * dt;
-
-        prevPos[index] = pos[index];
-        prevPos[index + 1] = pos[index + 1];
+void verlet(float* prevX, float* prevY, float* x, float* y, float* accX, float* accY,
+            int* radius, int nBalls, float width, float height, float dt = 1.0f,
+            BallCollider* collider = nullptr) {
+    IntegrateParams params;
+    params.dt = dt;
+    integrateVerlet(x, y, prevX, prevY, nullptr, accX, accY, nBalls, params);
 
-        pos[index] = nextX;
-        pos[index + 1] = nextY;
+    if (collider) {
+        collider->solve(x, y, radius, nBalls, width, height, COLLISION_ITERATIONS);
+    }
 
-        handleBoundaryCollision(prevPos, pos, index, radius[i]);
+    for (int i = 0; i < nBalls; i++) {
+        handleBoundaryCollision(prevX, prevY, x, y, i, radius[i], width, height);
     }
 }
 
@@ -108,8 +105,9 @@ void verlet(float* prevPos, float* pos, float* acc, int* radius, int nBalls, flo
 
 
 
-void initializeBalls(int* ballRadius, float* ballPrevPositions, float* ballPositions,
-                     float* ballAcceleration, float* ballColors, int nBalls) {
+void initializeBalls(int* ballRadius, float* ballPrevX, float* ballPrevY, float* ballX, float* ballY,
+                     float* ballAccX, float* ballAccY, float* ballColors, int nBalls,
+                     float width, float height) {
     static std::random_device rd;
     static std::mt19937 gen(rd());
 
@@ -127,35 +125,28 @@ void initializeBalls(int* ballRadius, float* ballPrevPositions, float* ballPosit
         float marginX = static_cast<float>(radius);
         float marginY = static_cast<float>(radius);
 
-        float posX = marginX + distPosX(gen) * (WINDOW_WIDTH - 2 * marginX);
-        float posY = marginY + distPosY(gen) * (WINDOW_HEIGHT - 2 * marginY);
+        float posX = marginX + distPosX(gen) * (width - 2 * marginX);
+        float posY = marginY + distPosY(gen) * (height - 2 * marginY);
 
-        ballPositions[i * 2 + 0] = posX;
-        ballPositions[i * 2 + 1] = posY;
+        ballX[i] = posX;
+        ballY[i] = posY;
 
         float offsetX = distOffset(gen);
         float offsetY = distOffset(gen);
 
-        ballPrevPositions[i * 2 + 0] = posX - offsetX;
-        ballPrevPositions[i * 2 + 1] = posY - offsetY;
+        ballPrevX[i] = posX - offsetX;
+        ballPrevY[i] = posY - offsetY;
 
         float accX = distAccX(gen);
         float accY = -G;
 
-        ballAcceleration[i * 2 + 0] = accX;
-        ballAcceleration[i * 2 + 1] = accY;
+        ballAccX[i] = accX;
+        ballAccY[i] = accY;
 
-        // Assign a random RGB color for each vertex in this ball
-        float r = distRGB(gen);
-        float g = distRGB(gen);
-        float b = distRGB(gen);
-
-        for (int j = 0; j < QUALITY + 2; ++j) {
-            int idx = (i * (QUALITY + 2) + j) * 3;
-            ballColors[idx + 0] = r;
-            ballColors[idx + 1] = g;
-            ballColors[idx + 2] = b;
-        }
+        // Assign a random RGB color for this ball
+        ballColors[i * 3 + 0] = distRGB(gen);
+        ballColors[i * 3 + 1] = distRGB(gen);
+        ballColors[i * 3 + 2] = distRGB(gen);
     }
 }
 
@@ -175,7 +166,25 @@ GLuint compileShader(GLenum type, const char* src) {
     return shader;
 }
 
-int main() {
+// Usage: BallsSimulation [count] [--no-collide]
+int main(int argc, char** argv) {
+    int nBalls = nBALLS;
+    bool collide = true;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--no-collide")) collide = false;
+        else nBalls = atoi(argv[i]);
+    }
+    if (nBalls <= 0) {
+        printf("usage: %s [count] [--no-collide]\n", argv[0]);
+        return 1;
+    }
+    const float worldScale = ballBoxScale(nBalls, MAXRADIUS, WINDOW_WIDTH, WINDOW_HEIGHT);
+    const float worldWidth = WINDOW_WIDTH * worldScale;
+    const float worldHeight = WINDOW_HEIGHT * worldScale;
+    JobSystem jobs;
+    BallCollider collider(MAXRADIUS);
+    if (jobs.threadCount() > 1) collider.jobs = &jobs;
+
     if (!glfwInit()) {
         printf("Failed to initialize GLFW3\n");
         return 1;
@@ -217,83 +226,98 @@ int main() {
 
     glDeleteShader(vertShader);
     glDeleteShader(fragShader);
+    GLint locPixelScale = glGetUniformLocation(shaderProgram, "uPixelScale");
+    GLint locWorldSize = glGetUniformLocation(shaderProgram, "uWorldSize");
 
-    // Prepare buffers
-    GLuint vao, vboPositions, vboColors;
+    // Initialize ball data
+    std::vector<int> ballRadius(nBalls);
+    std::vector<float> ballPrevX(nBalls), ballPrevY(nBalls);
+    std::vector<float> ballX(nBalls), ballY(nBalls);
+    std::vector<float> ballAccX(nBalls), ballAccY(nBalls);
+    std::vector<float> ballColors(nBalls * 3);  // RGB per ball
+
+    initializeBalls(ballRadius.data(), ballPrevX.data(), ballPrevY.data(), ballX.data(), ballY.data(),
+                ballAccX.data(), ballAccY.data(), ballColors.data(), nBalls, worldWidth, worldHeight);
+
+    // Prepare buffers: the x/y columns are streamed straight from the
+    // simulation arrays each frame; radius and colour never change, so
+    // they are uploaded once.
+    GLuint vao, vboX, vboY, vboRadius, vboColors;
     glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vboPositions);
+    glGenBuffers(1, &vboX);
+    glGenBuffers(1, &vboY);
+    glGenBuffers(1, &vboRadius);
     glGenBuffers(1, &vboColors);
 
     glBindVertexArray(vao);
 
-    // Position attribute (location = 0)
-    glBindBuffer(GL_ARRAY_BUFFER, vboPositions);
+    // Centre attributes (location = 0, 1)
+    glBindBuffer(GL_ARRAY_BUFFER, vboX);
+    glBufferData(GL_ARRAY_BUFFER, nBalls * sizeof(float), nullptr, GL_STREAM_DRAW);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-    // Color attribute (location = 1)
-    glBindBuffer(GL_ARRAY_BUFFER, vboColors);
+    glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glBindBuffer(GL_ARRAY_BUFFER, vboY);
+    glBufferData(GL_ARRAY_BUFFER, nBalls * sizeof(float), nullptr, GL_STREAM_DRAW);
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-    glBindVertexArray(0);
-
-    // Initialize ball data
-    std::vector<int> ballRadius(nBALLS);
-    std::vector<float> ballPrevPositions(nBALLS * 2);
-    std::vector<float> ballPositions(nBALLS * 2);
-    std::vector<float> ballAcceleration(nBALLS * 2);
-    std::vector<float> vertices(nBALLS * (QUALITY + 2) * 2);
-    std::vector<float> ballColors(nBALLS * (QUALITY + 2) * 3);  // RGB per vertex
-
-    initializeBalls(ballRadius.data(), ballPrevPositions.data(), ballPositions.data(),
-                ballAcceleration.data(), ballColors.data(), nBALLS);
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 0, nullptr);
 
+    // Radius attribute (location = 2), converted from int by GL
+    glBindBuffer(GL_ARRAY_BUFFER, vboRadius);
+    glBufferData(GL_ARRAY_BUFFER, nBalls * sizeof(int), ballRadius.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 1, GL_INT, GL_FALSE, 0, nullptr);
 
+    // Color attribute (location = 3)
+    glBindBuffer(GL_ARRAY_BUFFER, vboColors);
+    glBufferData(GL_ARRAY_BUFFER, ballColors.size() * sizeof(float), ballColors.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-    // Prepare vertices storage
-    float shapeVertices[(QUALITY + 2) * 2];
-    precomputeCircle(shapeVertices, QUALITY);
+    glBindVertexArray(0);
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_PROGRAM_POINT_SIZE);
 
     // Main loop
     while (!glfwWindowShouldClose(window)) {
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        verlet(ballPrevPositions.data(), ballPositions.data(), ballAcceleration.data(), ballRadius.data(), nBALLS, deltaTime);
-
-        for (int i = 0; i < nBALLS; ++i) {
-            updateBallVertices(
-                &vertices[i * (QUALITY + 2) * 2],
-                ballPositions[i * 2], ballPositions[i * 2 + 1],
-                (float)ballRadius[i],
-                shapeVertices, QUALITY);
-        }
-
-        glBindVertexArray(vao);
+        verlet(ballPrevX.data(), ballPrevY.data(), ballX.data(), ballY.data(),
+               ballAccX.data(), ballAccY.data(), ballRadius.data(), nBalls, worldWidth, worldHeight,
+               deltaTime, collide ? &collider : nullptr);
 
-        // Upload updated positions
-        glBindBuffer(GL_ARRAY_BUFFER, vboPositions);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_DYNAMIC_DRAW);
+        // Upload updated centres, orphaning last frame's storage
+        glBindBuffer(GL_ARRAY_BUFFER, vboX);
+        glBufferData(GL_ARRAY_BUFFER, nBalls * sizeof(float), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, nBalls * sizeof(float), ballX.data());
+        glBindBuffer(GL_ARRAY_BUFFER, vboY);
+        glBufferData(GL_ARRAY_BUFFER, nBalls * sizeof(float), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, nBalls * sizeof(float), ballY.data());
 
-        // Upload colors (static, but you can upload here once if no changes)
-        glBindBuffer(GL_ARRAY_BUFFER, vboColors);
-        glBufferData(GL_ARRAY_BUFFER, ballColors.size() * sizeof(float), ballColors.data(), GL_STATIC_DRAW);
+        int fbWidth, fbHeight;
+        glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
+        glViewport(0, 0, fbWidth, fbHeight);
 
         glUseProgram(shaderProgram);
-
-        for (int i = 0; i < nBALLS; ++i) {
-            glDrawArrays(GL_TRIANGLE_FAN, i * (QUALITY + 2), QUALITY + 2);
-        }
+        glUniform1f(locPixelScale, (float)fbWidth / worldWidth);
+        glUniform2f(locWorldSize, worldWidth, worldHeight);
+        glBindVertexArray(vao);
+        glDrawArrays(GL_POINTS, 0, nBalls);
 
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    glDeleteBuffers(1, &vboX);
+    glDeleteBuffers(1, &vboY);
+    glDeleteBuffers(1, &vboRadius);
+    glDeleteBuffers(1, &vboColors);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(shaderProgram);
+
     glfwDestroyWindow(window);
     glfwTerminate();
 
@@ -0,0 +1,339 @@
+// Microbenchmarks for the simulation core.
+// Usage: verlet_bench [--out results.json] [--quick] [--filter name]
+//
+// Every case times individual operations, so the report carries p50/p99
+// alongside the mean. Results are printed as a table and written as JSON
+// (tagged with the git revision) so runs can be compared across commits.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BallCollider.h"
+#include "ConstraintSolver.h"
+#include "JobSystem.h"
+#include "SceneIndex.h"
+#include "Simulation.h"
+#include "UniformGrid.h"
+#include "VerletKernel.h"
+
+#ifndef VERLET_GIT_REV
+#define VERLET_GIT_REV "unknown"
+#endif
+
+struct BenchResult {
+  std::string name;
+  std::string params;
+  long long nodes = 0;      // nodes touched per op, 0 for pure topology ops
+  int samples = 0;
+  double meanNs = 0.0;
+  double p50Ns = 0.0;
+  double p99Ns = 0.0;
+  double nodeStepsPerSec = 0.0;
+};
+
+static std::vector<BenchResult> results;
+static int gSamples = 200;
+static double gBudgetSeconds = 2.0;   // per case; large scenes stop sampling early
+static std::string gFilter;
+
+static double percentile(std::vector<double> &sorted, double q) {
+    if (sorted.empty()) return 0.0;
+    size_t idx = static_cast<size_t>(q * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+// Times `op` up to gSamples times (at least 5, within the time budget)
+// after a short warm-up and records the result.
+static void run(const std::string &name, const std::string &params, long long nodes,
+                const std::function<void()> &op) {
+    if (!gFilter.empty() && name.find(gFilter) == std::string::npos) return;
+
+    for (int i = 0; i < std::max(1, gSamples / 10); ++i) op();
+
+    std::vector<double> ns;
+    ns.reserve(gSamples);
+    double spent = 0.0;
+    for (int i = 0; i < gSamples && (i < 5 || spent < gBudgetSeconds * 1e9); ++i) {
+        auto begin = std::chrono::steady_clock::now();
+        op();
+        auto end = std::chrono::steady_clock::now();
+        ns.push_back(std::chrono::duration<double, std::nano>(end - begin).count());
+        spent += ns.back();
+    }
+
+    const int samples = static_cast<int>(ns.size());
+    double total = 0.0;
+    for (double v : ns) total += v;
+    std::sort(ns.begin(), ns.end());
+
+    BenchResult r;
+    r.name = name;
+    r.params = params;
+    r.nodes = nodes;
+    r.samples = samples;
+    r.meanNs = total / samples;
+    r.p50Ns = percentile(ns, 0.50);
+    r.p99Ns = percentile(ns, 0.99);
+    r.nodeStepsPerSec = (nodes > 0 && total > 0.0) ? nodes * samples / (total * 1e-9) : 0.0;
+    results.push_back(r);
+
+    std::printf("%-22s %-26s %12.0f ns/op  p50 %12.0f  p99 %12.0f  %10.3g node-steps/s\n",
+                r.name.c_str(), r.params.c_str(), r.meanNs, r.p50Ns, r.p99Ns, r.nodeStepsPerSec);
+}
+
+// Ropes laid out in rows and pinned at the first node, like the headless scene.
+static void buildRopes(Simulation &sim, int ropeCount, int ropeLength) {
+    sim.clear();
+    sim.params.width = 8000.0f;
+    sim.params.height = 6000.0f;
+    for (int l = 0; l < ropeCount; ++l) {
+        float start[3] = {50.0f + (l % 16) * 480.0f, sim.params.height - 50.0f - (l / 16) * 40.0f, 0.0f};
+        Line *line = sim.addLine(15.0f, ropeLength, start);
+        line->root().setFixed(true);
+    }
+}
+
+// Free single-node lines scattered over the box, for collision-heavy cases.
+static void buildBalls(Simulation &sim, int ballCount) {
+    sim.clear();
+    std::mt19937 gen(1234);
+    float side = std::sqrt(static_cast<float>(ballCount)) * BALL_RADIUS * 2.5f;
+    sim.params.width = side;
+    sim.params.height = side;
+    std::uniform_real_distribution<float> dist(BALL_RADIUS, side - BALL_RADIUS);
+    for (int i = 0; i < ballCount; ++i) {
+        float start[3] = {dist(gen), dist(gen), 0.0f};
+        sim.addLine(0.0f, 1, start);
+    }
+}
+
+static std::string ropeParams(int count, int length) {
+    return "ropes=" + std::to_string(count) + " length=" + std::to_string(length);
+}
+
+static void benchIntegration(int ropeCount, int ropeLength) {
+    Simulation sim;
+    buildRopes(sim, ropeCount, ropeLength);
+    DragInput noDrag;
+    run("integrate", ropeParams(ropeCount, ropeLength), sim.nodeCount(), [&] {
+        for (Line *line : sim.lines) {
+            integrateRange(sim.particles, line->first, line->first + line->size(), noDrag);
+        }
+    });
+}
+
+// One sweep, on a pool of every hardware thread as in the full step.
+static void benchConstraints(int ropeCount, int ropeLength) {
+    JobSystem jobs;
+    Simulation sim;
+    buildRopes(sim, ropeCount, ropeLength);
+    ConstraintSolver solver;
+    solver.build(sim.lines);
+    SolverSettings sweep;
+    sweep.maxIterations = 1;
+    sweep.jobs = &jobs;
+    run("constraint_sweep", ropeParams(ropeCount, ropeLength), sim.nodeCount(), [&] {
+        solver.solve(sim.particles, sweep);
+    });
+    SolverSettings direct = sweep;
+    direct.mode = SOLVER_DIRECT;
+    run("direct_chain_pass", ropeParams(ropeCount, ropeLength), sim.nodeCount(), [&] {
+        solver.solve(sim.particles, direct);
+    });
+}
+
+static void benchCollisions(Simulation &sim, const std::string &params) {
+    UniformGrid grid(BALL_RADIUS * 2.0f);
+    SceneIndex index;
+    std::vector<CollisionPair> intra, inter;
+    run("collision_pass", params, sim.nodeCount(), [&] {
+        index.refresh(sim.lines);
+        grid.build(sim.particles, index);
+        grid.findPairs(intra, inter);
+        for (const CollisionPair &pair : intra) {
+            resolveNodeCollision(sim.particles, pair.a, pair.b, BALL_RADIUS * 2.0f);
+        }
+        for (const CollisionPair &pair : inter) {
+            resolveNodeCollision(sim.particles, pair.a, pair.b, BALL_RADIUS * 2.0f);
+        }
+    });
+}
+
+// The a.cpp workload: free balls of radius 1..4 in an 800x600 box scaled
+// up until they cover half of it.
+static void benchBallRelax(int ballCount) {
+    const float scale = ballBoxScale(ballCount, 4, 800.0f, 600.0f);
+    const float width = 800.0f * scale, height = 600.0f * scale;
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<float> distX(0.0f, width), distY(0.0f, height);
+    std::uniform_int_distribution<int> distRadius(1, 4);
+    std::vector<float> x(ballCount), y(ballCount);
+    std::vector<int> radius(ballCount);
+    for (int i = 0; i < ballCount; ++i) {
+        x[i] = distX(gen);
+        y[i] = distY(gen);
+        radius[i] = distRadius(gen);
+    }
+    JobSystem jobs;
+    BallCollider collider(4.0f);
+    collider.jobs = &jobs;
+    run("ball_relax", "balls=" + std::to_string(ballCount), ballCount, [&] {
+        collider.solve(x.data(), y.data(), radius.data(), ballCount, width, height, 1);
+    });
+}
+
+static void benchStep(int ropeCount, int ropeLength) {
+    Simulation sim;
+    buildRopes(sim, ropeCount, ropeLength);
+    run("full_step", ropeParams(ropeCount, ropeLength), sim.nodeCount(), [&] { sim.step(); });
+}
+
+// Same scene with the per-line phases on a pool of every hardware thread.
+static void benchStepJobs(int ropeCount, int ropeLength) {
+    JobSystem jobs;
+    Simulation sim;
+    sim.jobs = &jobs;
+    buildRopes(sim, ropeCount, ropeLength);
+    run("full_step_jobs", ropeParams(ropeCount, ropeLength) + " threads=" + std::to_string(jobs.threadCount()),
+        sim.nodeCount(), [&] { sim.step(); });
+}
+
+static void benchTopology(int ropeLength) {
+    const std::string params = "length=" + std::to_string(ropeLength);
+
+    {
+        Simulation sim;
+        buildRopes(sim, 1, ropeLength);
+        run("split_join", params, 0, [&] {
+            Line *line = sim.lines[0];
+            auto [head, tail] = line->split(ropeLength / 2);
+            head->newTail(tail);
+            sim.lines[0] = head;
+            delete line;
+            delete tail;
+        });
+    }
+    {
+        // Two ropes whose ranges are not adjacent: joining must move nodes.
+        Simulation sim;
+        buildRopes(sim, 2, ropeLength);
+        float start[3] = {100.0f, 100.0f, 0.0f};
+        run("join_append", params, 0, [&] {
+            Line *piece = sim.addLine(15.0f, 1, start);
+            sim.joinLines(sim.lines[0], piece);
+        });
+    }
+    {
+        // The same, with an unrelated insert before every append that would
+        // take the join's slack if the line did not reserve it.
+        Simulation sim;
+        buildRopes(sim, 2, ropeLength);
+        float start[3] = {100.0f, 100.0f, 0.0f};
+        run("join_append_interleaved", params, 0, [&] {
+            sim.addLine(15.0f, 4, start);
+            Line *piece = sim.addLine(15.0f, 1, start);
+            sim.joinLines(sim.lines[0], piece);
+        });
+    }
+    {
+        Simulation sim;
+        buildRopes(sim, 1, ropeLength);
+        Node probe;
+        run("get_node", params, 0, [&] {
+            probe = sim.lines[0]->getNode(ropeLength - 1);
+        });
+    }
+    {
+        Simulation sim;
+        float start[3] = {100.0f, 100.0f, 0.0f};
+        run("insert_delete", params, 0, [&] {
+            Line *line = sim.addLine(15.0f, ropeLength, start);
+            sim.removeLine(line);
+        });
+    }
+}
+
+static void writeJson(const std::string &path) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Could not write " << path << "\n";
+        return;
+    }
+    out << "{\n";
+    out << "  \"commit\": \"" << VERLET_GIT_REV << "\",\n";
+    out << "  \"kernel\": \"" << integrateKernelName() << "\",\n";
+    out << "  \"samples\": " << gSamples << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult &r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"params\": \"" << r.params << "\""
+            << ", \"nodes\": " << r.nodes
+            << ", \"samples\": " << r.samples
+            << ", \"ns_per_op\": " << r.meanNs
+            << ", \"p50_ns\": " << r.p50Ns
+            << ", \"p99_ns\": " << r.p99Ns
+            << ", \"node_steps_per_sec\": " << r.nodeStepsPerSec << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    std::cout << "Wrote " << results.size() << " results to " << path << "\n";
+}
+
+int main(int argc, char **argv) {
+    std::string outPath = "bench_results.json";
+    bool quick = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--out") && i + 1 < argc) outPath = argv[++i];
+        else if (!std::strcmp(argv[i], "--quick")) quick = true;
+        else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc) gFilter = argv[++i];
+        else {
+            std::cerr << "usage: " << argv[0] << " [--out results.json] [--quick] [--filter name]\n";
+            return 1;
+        }
+    }
+    if (quick) {
+        gSamples = 20;
+        gBudgetSeconds = 0.5;
+    }
+
+    const std::vector<int> ropeLengths = quick ? std::vector<int>{64, 1024} : std::vector<int>{64, 1024, 8192};
+    const std::vector<int> ropeCounts = quick ? std::vector<int>{1, 16} : std::vector<int>{1, 16, 128};
+    const std::vector<int> ballCounts = quick ? std::vector<int>{1000} : std::vector<int>{1000, 10000, 100000};
+
+    std::cout << "verlet_bench @ " << VERLET_GIT_REV << " (kernel: " << integrateKernelName() << ")\n";
+    for (int count : ropeCounts) {
+        for (int length : ropeLengths) {
+            benchIntegration(count, length);
+            benchConstraints(count, length);
+            benchStep(count, length);
+            benchStepJobs(count, length);
+        }
+    }
+    for (int length : ropeLengths) {
+        Simulation sim;
+        buildRopes(sim, 16, length);
+        for (int s = 0; s < 50; ++s) sim.step();  // let ropes hang and touch
+        benchCollisions(sim, ropeParams(16, length));
+    }
+    for (int balls : ballCounts) {
+        Simulation sim;
+        buildBalls(sim, balls);
+        benchCollisions(sim, "balls=" + std::to_string(balls));
+        benchBallRelax(balls);
+    }
+    for (int length : ropeLengths) {
+        benchTopology(length);
+    }
+
+    writeJson(outPath);
+    return 0;
+}
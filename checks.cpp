@@ -0,0 +1,606 @@
+// Regression checks for the simulation core, run by ctest.
+// Usage: verlet_checks [name]
+//
+// Each check builds a small scene, prints one line with what it measured
+// and fails the run (non-zero exit) if an invariant does not hold.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ConstraintSolver.h"
+#include "JobSystem.h"
+#include "SceneIndex.h"
+#include "Simulation.h"
+#include "Snapshot.h"
+#include "TrajectoryRecorder.h"
+#include "UniformGrid.h"
+#include "VerletKernel.h"
+
+struct Check {
+    const char *name;
+    std::function<bool()> run;
+};
+
+static bool expect(bool condition, const char *what) {
+    if (!condition) std::printf("    FAILED: %s\n", what);
+    return condition;
+}
+
+// Two edits in one frame: the first shifts every later line down one slot
+// in `lines`, the second must still wake the sleeper that rested on the
+// line it removes.
+static bool wakeAfterTwoEdits() {
+    Simulation sim;
+    sim.params.sleepEnergy = 0.0f;
+    const float spacing = sim.params.radius * 2.0f;
+    float start[2] = {100.0f, 100.0f};
+    sim.addLine(spacing, 10, start);
+    start[1] = 200.0f;
+    sim.addLine(spacing, 10, start);
+    start[1] = 300.0f;
+    Line *support = sim.addLine(spacing, 10, start);
+    start[1] = 300.0f + sim.params.radius;
+    Line *sleeper = sim.addLine(spacing, 10, start);
+    sim.step();
+
+    sleeper->asleep = true;
+    sim.removeLine(sim.lines[0]);
+    sim.removeLine(support);
+    std::printf("  sleeper %s after removing its support\n", sleeper->asleep ? "asleep" : "awake");
+    return expect(!sleeper->asleep, "line resting on a removed line is woken");
+}
+
+// Dragging a line away must wake the sleeper resting on it; once moved it
+// is no longer a collision candidate, so nothing else would.
+static bool wakeAfterMove() {
+    Simulation sim;
+    const float spacing = sim.params.radius * 2.0f;
+    float start[2] = {100.0f, 300.0f};
+    Line *support = sim.addLine(spacing, 10, start);
+    start[1] = 300.0f + sim.params.radius;
+    Line *sleeper = sim.addLine(spacing, 10, start);
+    sim.step();
+
+    sleeper->asleep = true;
+    sim.moveLine(support, 0.0f, 200.0f);
+    std::printf("  sleeper %s after moving its support\n", sleeper->asleep ? "asleep" : "awake");
+    return expect(!sleeper->asleep, "line resting on a moved line is woken");
+}
+
+// Hanging ropes under the given solver on a pool of the given number of
+// threads; returns the final state hash. Big enough that every phase,
+// the constraint solve included, actually runs in parallel.
+static uint64_t threadedHash(SolverMode mode, int threads) {
+    JobSystem jobs(threads);
+    Simulation sim;
+    if (jobs.threadCount() > 1) sim.jobs = &jobs;
+    sim.params.solverMode = mode;
+    sim.params.width = 4000.0f;
+    sim.params.height = 3000.0f;
+    for (int l = 0; l < 32; ++l) {
+        float start[2] = {50.0f + (l % 8) * 480.0f, 2950.0f - (l / 8) * 40.0f};
+        sim.addLine(15.0f, 200, start)->root().setFixed(true);
+    }
+    for (int s = 0; s < 100; ++s) sim.step();
+    return sim.stateHash();
+}
+
+static bool jacobiThreadInvariant() {
+    const uint64_t serial = threadedHash(SOLVER_JACOBI, 1);
+    const uint64_t parallel = threadedHash(SOLVER_JACOBI, 8);
+    std::printf("  state hash %016llx with 1 thread, %016llx with 8\n",
+                static_cast<unsigned long long>(serial), static_cast<unsigned long long>(parallel));
+    return expect(serial == parallel, "jacobi state hash is the same for any thread count");
+}
+
+// Links of one colour never share a node, so the red and black blocks can
+// run on any thread in any order and the result must not change.
+static bool pbdThreadInvariant() {
+    const uint64_t serial = threadedHash(SOLVER_PBD, 1);
+    const uint64_t parallel = threadedHash(SOLVER_PBD, 8);
+    std::printf("  state hash %016llx with 1 thread, %016llx with 8\n",
+                static_cast<unsigned long long>(serial), static_cast<unsigned long long>(parallel));
+    return expect(serial == parallel, "red/black state hash is the same for any thread count");
+}
+
+// A saved world loads back bit-identical, per-line compliance and the
+// saved params included.
+static bool snapshotRoundTrip() {
+    const char *path = "verlet_checks_snapshot.bin";
+    Simulation saved;
+    saved.params.solverMode = SOLVER_XPBD;
+    float start[2] = {100.0f, 100.0f};
+    saved.addLine(15.0f, 20, start)->root().setFixed(true);
+    saved.setCompliance(0.01f);
+    start[0] = 400.0f;
+    saved.addLine(10.0f, 30, start)->getNode(29).setFixed(true);
+    for (int s = 0; s < 10; ++s) saved.step();
+
+    Simulation loaded;
+    bool ok = expect(saveSnapshot(saved, path), "snapshot saves");
+    ok &= expect(loadSnapshot(loaded, path), "snapshot loads");
+    std::remove(path);
+    if (!ok) return false;
+    std::printf("  state hash %016llx saved, %016llx loaded\n",
+                static_cast<unsigned long long>(saved.stateHash()),
+                static_cast<unsigned long long>(loaded.stateHash()));
+    ok &= expect(loaded.stateHash() == saved.stateHash(), "loaded state is bit-identical");
+    ok &= expect(loaded.lines.size() == 2 && loaded.lines[0]->compliance == 0.01f, "line compliance survives");
+    ok &= expect(loaded.params.solverMode == SOLVER_XPBD, "solver mode survives");
+    ok &= expect(loaded.particles.stats().live == loaded.nodeCount(), "every loaded particle belongs to a line");
+    return ok;
+}
+
+// A free particle with zero inverse mass (a pin whose flag was lost) is
+// rejected and leaves the simulation as it was.
+static bool snapshotRejectsBadPin() {
+    const char *path = "verlet_checks_snapshot.bin";
+    Simulation saved;
+    float start[2] = {100.0f, 100.0f};
+    saved.addLine(15.0f, 20, start)->root().setFixed(true);
+    bool ok = expect(saveSnapshot(saved, path), "snapshot saves");
+
+    // flags is the last column, so the root's flags are n bytes from the end.
+    if (FILE *file = std::fopen(path, "r+b")) {
+        std::fseek(file, -saved.nodeCount(), SEEK_END);
+        std::fputc(PARTICLE_ALIVE, file);
+        std::fclose(file);
+    }
+    Simulation loaded;
+    float other[2] = {300.0f, 100.0f};
+    loaded.addLine(15.0f, 5, other);
+    ok &= expect(!loadSnapshot(loaded, path), "unpinned particle with zero inverse mass is rejected");
+    std::remove(path);
+    ok &= expect(loaded.lines.size() == 1 && loaded.nodeCount() == 5, "failed load leaves the simulation alone");
+    return ok;
+}
+
+// A NaN time step or a negative rest length is rejected before the
+// simulation is cleared.
+static bool snapshotRejectsBadParams() {
+    const char *path = "verlet_checks_snapshot.bin";
+    Simulation saved;
+    float start[2] = {100.0f, 100.0f};
+    saved.addLine(15.0f, 20, start)->root().setFixed(true);
+    bool ok = true;
+
+    // The line table starts right after the 80-byte header.
+    const long corruptions[] = {
+        static_cast<long>(offsetof(SnapshotHeader, timeStep)),
+        static_cast<long>(sizeof(SnapshotHeader) + offsetof(SnapshotLine, delta)),
+    };
+    const float values[] = {NAN, -15.0f};
+    for (int c = 0; c < 2; ++c) {
+        ok &= expect(saveSnapshot(saved, path), "snapshot saves");
+        if (FILE *file = std::fopen(path, "r+b")) {
+            std::fseek(file, corruptions[c], SEEK_SET);
+            std::fwrite(&values[c], sizeof(float), 1, file);
+            std::fclose(file);
+        }
+        Simulation loaded;
+        float other[2] = {300.0f, 100.0f};
+        loaded.addLine(15.0f, 5, other);
+        ok &= expect(!loadSnapshot(loaded, path), c == 0 ? "NaN time step is rejected" : "negative rest length is rejected");
+        ok &= expect(loaded.lines.size() == 1 && loaded.nodeCount() == 5, "failed load leaves the simulation alone");
+    }
+    std::remove(path);
+    return ok;
+}
+
+// A chain pinned at one end, released horizontally and swinging under
+// gravity: after every SOLVER_DIRECT solve() each segment is back at its
+// rest length, the tridiagonal pass reaching the whole chain at once
+// instead of one segment per sweep.
+static bool directChainAtRest() {
+    ParticleStore p;
+    const float rest = 10.0f;
+    float start[2] = {100.0f, 100.0f};
+    Line line(p, rest, 100, start);
+    line.root().setFixed(true);
+    const int end = line.first + line.size();
+    for (int i = line.first; i < end; ++i) {
+        p.prevX[i] = p.x[i];
+        p.prevY[i] = p.y[i];
+    }
+
+    ConstraintSolver solver;
+    solver.build({&line});
+    SolverSettings settings;
+    settings.mode = SOLVER_DIRECT;
+    settings.timeStep = DT;
+
+    float worst = 0.0f;
+    for (int step = 0; step < 200; ++step) {
+        for (int i = line.first; i < end; ++i) {
+            if (p.isFixed(i)) continue;
+            const float x = p.x[i], y = p.y[i];
+            p.x[i] += x - p.prevX[i];
+            p.y[i] += y - p.prevY[i] + GRAVITY * DT * DT;
+            p.prevX[i] = x;
+            p.prevY[i] = y;
+        }
+        solver.solve(p, settings);
+        for (int i = line.first; i + 1 < end; ++i) {
+            const float dist = std::hypot(p.x[i + 1] - p.x[i], p.y[i + 1] - p.y[i]);
+            worst = std::max(worst, std::fabs(dist - rest) / rest);
+        }
+    }
+    std::printf("  max relative stretch after a solve: %g\n", worst);
+    return expect(worst < 1e-3f, "direct solve leaves every segment at rest length");
+}
+
+// Frames recorded across several chunks read back, in any order, to within
+// the quantisation step (half a quantum, plus float rounding).
+static bool trajectoryRoundTrip() {
+    const char *path = "verlet_checks_trajectory.bin";
+    const float quantum = 1.0f / 64.0f;
+    const int frames = 20;
+    Simulation sim;
+    float start[2] = {100.0f, 100.0f};
+    sim.addLine(15.0f, 30, start)->root().setFixed(true);
+    start[0] = 400.0f;
+    sim.addLine(10.0f, 40, start)->root().setFixed(true);
+
+    // A slot per frame, so none are dropped however slow the writer is.
+    TrajectoryRecorder recorder(1, frames, quantum, 6);
+    if (!expect(recorder.open(path), "trajectory opens")) return false;
+    std::vector<std::vector<float>> xs, ys;
+    for (int f = 0; f < frames; ++f) {
+        sim.step();
+        recorder.capture(sim);
+        xs.emplace_back();
+        ys.emplace_back();
+        for (const Line *line : sim.lines) {
+            xs.back().insert(xs.back().end(), sim.particles.x.begin() + line->first,
+                             sim.particles.x.begin() + line->first + line->size());
+            ys.back().insert(ys.back().end(), sim.particles.y.begin() + line->first,
+                             sim.particles.y.begin() + line->first + line->size());
+        }
+    }
+    recorder.close();
+
+    TrajectoryReader reader;
+    bool ok = expect(reader.open(path), "trajectory reads");
+    ok &= expect(reader.frameCount() == frames, "every frame is recorded");
+    float worst = 0.0f;
+    std::vector<float> x, y;
+    for (int k = 0; ok && k < frames; ++k) {
+        const int f = (k * 7) % frames;  // out of order, so chunks are revisited
+        ok &= expect(reader.readFrame(f, x, y) == f, "frame number reads back");
+        ok &= expect(x.size() == xs[f].size() && y.size() == ys[f].size(), "node count reads back");
+        for (size_t i = 0; ok && i < x.size(); ++i) {
+            worst = std::max(worst, std::max(std::fabs(x[i] - xs[f][i]), std::fabs(y[i] - ys[f][i])));
+        }
+    }
+    reader.close();
+    std::remove(path);
+    std::printf("  worst position error %g (quantum %g)\n", worst, quantum);
+    return ok && expect(worst < quantum, "positions read back to within the quantisation step");
+}
+
+// A cut keeps the node count but renumbers the nodes after it, so the
+// recorder has to start a new chunk instead of storing deltas against the
+// old order.
+static bool trajectoryChunksOnCut() {
+    const char *path = "verlet_checks_trajectory.bin";
+    Simulation sim;
+    float start[2] = {100.0f, 100.0f};
+    Line *first = sim.addLine(15.0f, 30, start);
+    first->root().setFixed(true);
+    start[0] = 400.0f;
+    sim.addLine(10.0f, 40, start)->root().setFixed(true);
+
+    TrajectoryRecorder recorder(1, 16, 1.0f / 64.0f, 64);
+    if (!expect(recorder.open(path), "trajectory opens")) return false;
+    for (int f = 0; f < 10; ++f) {
+        if (f == 5) sim.splitLine(first, 10);
+        sim.step();
+        recorder.capture(sim);
+    }
+    recorder.close();
+
+    TrajectoryReader reader;
+    bool ok = expect(reader.open(path), "trajectory reads");
+    const int chunks = reader.chunkCount();
+    reader.close();
+    std::remove(path);
+    std::printf("  %d chunks for 10 frames with one cut\n", chunks);
+    return ok & expect(chunks == 2, "a cut starts a new chunk");
+}
+
+// A join that has to relocate reserves slack on the line; an insert in
+// between must not take it, so the next append lands in place.
+static bool joinSlackReserved() {
+    Simulation sim;
+    float start[2] = {100.0f, 100.0f};
+    Line *line = sim.addLine(10.0f, 30, start);
+    sim.addLine(10.0f, 10, start);  // keeps line and back apart
+    Line *back = sim.addLine(10.0f, 10, start);
+    sim.joinLines(line, back);
+    const int first = line->first;
+
+    sim.addLine(10.0f, 15, start);  // best fit is the slack, if it is free
+    sim.joinLines(line, sim.addLine(10.0f, 1, start));
+    std::printf("  line at %d after the relocating join, %d after an insert and append\n", first, line->first);
+    return expect(line->first == first && line->size() == 41, "append after an insert stays in place");
+}
+
+// Editing a line's compliance in place is a change the solver must see,
+// so the cached index has to notice it without an invalidate().
+static bool sceneIndexSeesCompliance() {
+    ParticleStore store;
+    float start[2] = {100.0f, 100.0f};
+    Line line(store, 10.0f, 5, start);
+    const std::vector<Line*> lines = {&line};
+    SceneIndex index;
+    index.refresh(lines);
+    bool ok = expect(!index.refresh(lines), "unchanged scene keeps its index");
+    line.compliance = 0.01f;
+    const bool rebuilt = index.refresh(lines);
+    std::printf("  index %s after a compliance change\n", rebuilt ? "rebuilt" : "kept");
+    return ok & expect(rebuilt, "compliance change rebuilds the index");
+}
+
+// Every pair of nodes closer than a cell, except neighbours on the same
+// rope, comes out of the grid exactly once and in the right list; pairs
+// where both lines sleep are left out. One stray node widens the cells.
+static bool gridMatchesBruteForce() {
+    Simulation sim;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> coord(0.0f, 300.0f);
+    float start[2] = {0.0f, 0.0f};
+    for (int l = 0; l < 12; ++l) sim.addLine(5.0f, 40, start);
+    ParticleStore &p = sim.particles;
+    for (const Line *line : sim.lines) {
+        for (int i = line->first; i < line->first + line->count; ++i) {
+            p.x[i] = coord(rng);
+            p.y[i] = coord(rng);
+        }
+    }
+    p.x[sim.lines[0]->first] = 3000.0f;
+
+    SceneIndex index;
+    index.refresh(sim.lines);
+    std::vector<uint8_t> active(sim.lines.size(), 1);
+    active[3] = active[4] = 0;
+    const float cell = 10.0f;
+    UniformGrid grid(cell);
+    grid.build(p, index, active.data());
+    std::vector<CollisionPair> intra, inter;
+    grid.findPairs(intra, inter);
+
+    auto key = [](const CollisionPair &pair) { return (static_cast<long long>(pair.a) << 32) | pair.b; };
+    std::vector<long long> gridIntra, gridInter;
+    for (const CollisionPair &pair : intra) gridIntra.push_back(key(pair));
+    for (const CollisionPair &pair : inter) gridInter.push_back(key(pair));
+    std::sort(gridIntra.begin(), gridIntra.end());
+    std::sort(gridInter.begin(), gridInter.end());
+    bool ok = expect(std::adjacent_find(gridIntra.begin(), gridIntra.end()) == gridIntra.end() &&
+                     std::adjacent_find(gridInter.begin(), gridInter.end()) == gridInter.end(),
+                     "no pair is emitted twice");
+
+    long long close = 0;
+    bool found = true;
+    bool asleep = true;
+    const int n = static_cast<int>(index.nodes.size());
+    for (int s = 0; s < n; ++s) {
+        for (int t = s + 1; t < n; ++t) {
+            const int a = index.nodes[s], b = index.nodes[t];
+            const int lineA = index.nodeLine[s], lineB = index.nodeLine[t];
+            if (lineA == lineB && b - a == 1) continue;
+            const long long k = key({std::min(a, b), std::max(a, b)});
+            const std::vector<long long> &list = lineA == lineB ? gridIntra : gridInter;
+            const bool emitted = std::binary_search(list.begin(), list.end(), k);
+            if (!active[lineA] && !active[lineB]) {
+                asleep &= !emitted;
+                continue;
+            }
+            if (std::hypot(p.x[a] - p.x[b], p.y[a] - p.y[b]) >= cell) continue;
+            close++;
+            found &= emitted;
+        }
+    }
+    std::printf("  %lld close pairs, %zu candidates\n", close, intra.size() + inter.size());
+    ok &= expect(close > 0, "the scene has close pairs");
+    ok &= expect(found, "every close pair is a candidate in the right list");
+    ok &= expect(asleep, "pairs between sleeping lines are skipped");
+    return ok;
+}
+
+// The dispatched kernel matches the scalar loop bit for bit, with fixed
+// nodes mixed in and a count that leaves a tail for every lane width,
+// both with per-particle and with uniform acceleration.
+static bool simdMatchesScalar() {
+    const int count = 8 * 5 + 5;
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> coord(-500.0f, 500.0f);
+    std::vector<float> x(count), y(count), prevX(count), prevY(count), invMass(count), accX(count), accY(count);
+    for (int i = 0; i < count; ++i) {
+        x[i] = coord(rng);
+        y[i] = coord(rng);
+        prevX[i] = x[i] + coord(rng) * 0.01f;
+        prevY[i] = y[i] + coord(rng) * 0.01f;
+        invMass[i] = i % 3 == 0 ? 0.0f : 1.0f;
+        accX[i] = coord(rng);
+        accY[i] = coord(rng);
+    }
+    IntegrateParams params;
+    params.damping = 0.99f;
+    params.ax = 3.0f;
+    params.ay = 9.8f;
+    params.dt = 1.0f / 60.0f;
+
+    std::printf("  %s kernel\n", integrateKernelName());
+    bool ok = true;
+    for (int uniform = 0; uniform < 2; ++uniform) {
+        const float *ax = uniform ? nullptr : accX.data();
+        const float *ay = uniform ? nullptr : accY.data();
+        std::vector<float> sx = x, sy = y, spx = prevX, spy = prevY;
+        std::vector<float> vx = x, vy = y, vpx = prevX, vpy = prevY;
+        for (int s = 0; s < 10; ++s) {
+            integrateVerletScalar(sx.data(), sy.data(), spx.data(), spy.data(), invMass.data(), ax, ay, count, params);
+            integrateVerlet(vx.data(), vy.data(), vpx.data(), vpy.data(), invMass.data(), ax, ay, count, params);
+        }
+        const size_t bytes = count * sizeof(float);
+        ok &= expect(std::memcmp(sx.data(), vx.data(), bytes) == 0 && std::memcmp(sy.data(), vy.data(), bytes) == 0 &&
+                     std::memcmp(spx.data(), vpx.data(), bytes) == 0 && std::memcmp(spy.data(), vpy.data(), bytes) == 0,
+                     uniform ? "uniform acceleration matches the scalar loop" : "per-particle acceleration matches the scalar loop");
+        bool pinned = true;
+        for (int i = 0; i < count; i += 3) pinned &= vx[i] == x[i] && vy[i] == y[i] && vpx[i] == prevX[i];
+        ok &= expect(pinned, "fixed nodes are left untouched");
+    }
+    return ok;
+}
+
+// A line at its rest length stops after one sweep once tolerances are
+// set, and a projection budget is never overrun.
+static bool solverToleranceAndBudget() {
+    Simulation sim;
+    float start[2] = {100.0f, 100.0f};
+    sim.addLine(15.0f, 100, start)->root().setFixed(true);
+    start[1] = 300.0f;
+    sim.addLine(15.0f, 100, start)->root().setFixed(true);
+    ConstraintSolver solver;
+    solver.build(sim.lines);
+
+    SolverSettings settings;
+    settings.maxIterations = 32;
+    solver.solve(sim.particles, settings);
+    bool ok = expect(solver.stats().sweeps == 32 && solver.stats().convergedLines == 0,
+                     "without tolerances every sweep runs");
+
+    settings.maxStretchTolerance = 0.01f;
+    settings.rmsStretchTolerance = 0.005f;
+    solver.solve(sim.particles, settings);
+    std::printf("  resting lines: %d sweeps, %d converged\n", solver.stats().sweeps, solver.stats().convergedLines);
+    ok &= expect(solver.stats().sweeps == 1 && solver.stats().convergedLines == 2, "resting lines stop after one sweep");
+
+    // Stretch both lines so they would keep sweeping, then cap the work.
+    for (const Line *line : sim.lines) {
+        for (int i = line->first; i < line->first + line->count; ++i) sim.particles.x[i] *= 1.5f;
+    }
+    settings.maxStretchTolerance = 0.0f;
+    settings.rmsStretchTolerance = 0.0f;
+    settings.budget = 500;
+    solver.solve(sim.particles, settings);
+    std::printf("  budget %lld: %lld projections over %d sweeps\n", settings.budget, solver.stats().projections,
+                solver.stats().sweeps);
+    ok &= expect(solver.stats().projections <= settings.budget, "projections stay within the budget");
+    ok &= expect(solver.stats().budgetExhausted && solver.stats().sweeps < settings.maxIterations,
+                 "the budget stops the solve early");
+    return ok;
+}
+
+// Relative stretch of a hanging compliant rope after it settles under
+// XPBD with a fixed number of sweeps per step.
+static float xpbdStretch(int sweeps) {
+    Simulation sim;
+    sim.params.solverMode = SOLVER_XPBD;
+    sim.params.iterations = sweeps;
+    sim.params.maxStretchTolerance = 0.0f;
+    sim.params.rmsStretchTolerance = 0.0f;
+    sim.params.compliance = 0.01f;
+    float start[2] = {400.0f, 580.0f};
+    Line *line = sim.addLine(15.0f, 20, start);
+    line->root().setFixed(true);
+    for (int s = 0; s < 600; ++s) sim.step();
+
+    const ParticleStore &p = sim.particles;
+    double length = 0.0;
+    for (int i = line->first; i + 1 < line->first + line->count; ++i) {
+        length += std::hypot(p.x[i + 1] - p.x[i], p.y[i + 1] - p.y[i]);
+    }
+    return static_cast<float>(length / (line->delta * (line->count - 1)) - 1.0);
+}
+
+// XPBD's stiffness comes from the compliance, not the sweep count: a
+// compliant rope stretches about as far with 8 sweeps as with 32.
+static bool xpbdSweepInvariant() {
+    const float few = xpbdStretch(8);
+    const float many = xpbdStretch(32);
+    std::printf("  stretch %.4f with 8 sweeps, %.4f with 32\n", few, many);
+    bool ok = expect(many > 0.01f, "the compliant rope visibly stretches");
+    ok &= expect(std::fabs(few - many) < 0.1f * many, "stretch is within 10% across sweep counts");
+    return ok;
+}
+
+// One PBD sweep with attachments pulls a rope stretched to three times its
+// rest length back within reach of its pin, and pinning or unpinning a
+// node rebuilds the attachments on the next step.
+static bool attachmentsBoundRope() {
+    Simulation sim;
+    float start[2] = {400.0f, 100.0f};
+    Line *line = sim.addLine(15.0f, 40, start);
+    line->root().setFixed(true);
+    ParticleStore &p = sim.particles;
+    for (int s = 1; s < line->count; ++s) p.y[line->first + s] = 100.0f + s * line->delta * 3.0f;
+
+    ConstraintSolver solver;
+    solver.build(sim.lines);
+    SolverSettings settings;
+    settings.maxIterations = 1;
+    settings.attachments = true;
+    solver.solve(p, settings);
+    double length = 0.0;
+    bool bounded = true;
+    for (int s = 1; s < line->count; ++s) {
+        const int i = line->first + s;
+        length += std::hypot(p.x[i] - p.x[i - 1], p.y[i] - p.y[i - 1]);
+        bounded &= std::hypot(p.x[i] - p.x[line->first], p.y[i] - p.y[line->first]) <= s * line->delta * 1.0001f;
+    }
+    const double rest = line->delta * (line->count - 1);
+    std::printf("  length %.1f after one sweep, rest %.1f\n", length, rest);
+    bool ok = expect(bounded, "every node is within its attachment distance of the pin");
+    ok &= expect(length <= rest * 1.0001, "rope length is within the attachment bound");
+
+    sim.step();
+    const int single = sim.solverStats().attachments;
+    line->getNode(line->count - 1).setFixed(true);
+    sim.step();
+    const int both = sim.solverStats().attachments;
+    line->root().setFixed(false);
+    sim.step();
+    const int tail = sim.solverStats().attachments;
+    std::printf("  attachments %d pinned at the root, %d at both ends, %d at the tail\n", single, both, tail);
+    ok &= expect(single == line->count - 1 && both == 2 * (line->count - 2) && tail == line->count - 1,
+                 "pin toggles rebuild the attachments");
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const std::vector<Check> checks = {
+        {"wake_after_two_edits", wakeAfterTwoEdits},
+        {"wake_after_move", wakeAfterMove},
+        {"jacobi_thread_invariant", jacobiThreadInvariant},
+        {"pbd_thread_invariant", pbdThreadInvariant},
+        {"snapshot_round_trip", snapshotRoundTrip},
+        {"snapshot_rejects_bad_pin", snapshotRejectsBadPin},
+        {"snapshot_rejects_bad_params", snapshotRejectsBadParams},
+        {"direct_chain_at_rest", directChainAtRest},
+        {"trajectory_round_trip", trajectoryRoundTrip},
+        {"trajectory_chunks_on_cut", trajectoryChunksOnCut},
+        {"join_slack_reserved", joinSlackReserved},
+        {"scene_index_sees_compliance", sceneIndexSeesCompliance},
+        {"grid_matches_brute_force", gridMatchesBruteForce},
+        {"simd_matches_scalar", simdMatchesScalar},
+        {"solver_tolerance_and_budget", solverToleranceAndBudget},
+        {"xpbd_sweep_invariant", xpbdSweepInvariant},
+        {"attachments_bound_rope", attachmentsBoundRope},
+    };
+
+    int failed = 0;
+    for (const Check &check : checks) {
+        if (argc > 1 && std::strcmp(argv[1], check.name) != 0) continue;
+        std::printf("%s\n", check.name);
+        if (!check.run()) failed++;
+    }
+    std::printf("%d failed\n", failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+// Steps a rope scene without a window and reports solver throughput.
+// Usage: verlet_headless [steps] [lines] [nodesPerLine] [--load snapshot] [--save snapshot]
+//                        [--record trajectory] [--every N] [--threads N]
+//                        [--solver pbd|xpbd|direct|jacobi] [--compliance C] [--no-attachments]
+//
+// --load replaces the generated scene with a saved one (the line/node
+// counts are then ignored); --save writes the state after the last step.
+// --record streams every N-th step's positions to a trajectory file.
+// --threads sizes the worker pool for the per-line phases and the
+// constraint solve (default: one per hardware thread, 1 runs them
+// serially); nothing else starts threads. Per-worker utilisation is
+// reported at the end.
+// --solver picks the distance-constraint solver; --compliance gives every
+// segment that XPBD compliance (inverse stiffness, 0 = rigid).
+// --no-attachments turns off the long-range attachments to pinned nodes.
+// The final state hash is printed so runs can be compared bit for bit.
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "Simulation.h"
+#include "Snapshot.h"
+#include "TrajectoryRecorder.h"
+#include "VerletKernel.h"
+
+int main(int argc, char **argv) {
+    int positional[3] = {1000, 16, 64};
+    int numPositional = 0;
+    const char *loadPath = nullptr;
+    const char *savePath = nullptr;
+    const char *recordPath = nullptr;
+    int recordEvery = 1;
+    int threads = 0;
+    const char *solverName = nullptr;
+    float compliance = 0.0f;
+    bool attachments = true;
+    bool badArgs = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--load") && i + 1 < argc) loadPath = argv[++i];
+        else if (!std::strcmp(argv[i], "--save") && i + 1 < argc) savePath = argv[++i];
+        else if (!std::strcmp(argv[i], "--record") && i + 1 < argc) recordPath = argv[++i];
+        else if (!std::strcmp(argv[i], "--every") && i + 1 < argc) recordEvery = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--threads") && i + 1 < argc) threads = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--solver") && i + 1 < argc) solverName = argv[++i];
+        else if (!std::strcmp(argv[i], "--compliance") && i + 1 < argc) compliance = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--no-attachments")) attachments = false;
+        else if (argv[i][0] != '-' && numPositional < 3) positional[numPositional++] = std::atoi(argv[i]);
+        else badArgs = true;
+    }
+    int solverMode = SOLVER_PBD;
+    if (solverName) {
+        for (solverMode = 0; solverMode < SOLVER_MODE_COUNT; ++solverMode) {
+            if (!std::strcmp(solverName, solverModeName(static_cast<SolverMode>(solverMode)))) break;
+        }
+        if (solverMode == SOLVER_MODE_COUNT) badArgs = true;
+    }
+    int steps = positional[0];
+    int numLines = positional[1];
+    int nodesPerLine = positional[2];
+    if (badArgs || steps <= 0 || numLines <= 0 || nodesPerLine < 2 || recordEvery <= 0 || threads < 0 || compliance < 0.0f) {
+        std::cerr << "usage: " << argv[0]
+                  << " [steps] [lines] [nodesPerLine] [--load snapshot] [--save snapshot]"
+                  << " [--record trajectory] [--every N] [--threads N]"
+                  << " [--solver pbd|xpbd|direct|jacobi] [--compliance C] [--no-attachments]\n";
+        return 1;
+    }
+
+    JobSystem jobs(threads);
+    Simulation sim;
+    if (jobs.threadCount() > 1) sim.jobs = &jobs;
+    sim.params.width = 4000.0f;
+    sim.params.height = 3000.0f;
+
+    if (loadPath) {
+        auto loadBegin = std::chrono::steady_clock::now();
+        if (!loadSnapshot(sim, loadPath)) return 1;
+        auto loadEnd = std::chrono::steady_clock::now();
+        numLines = static_cast<int>(sim.lines.size());
+        std::cout << "loaded " << loadPath << " (" << sim.nodeCount() << " nodes) in "
+                  << std::chrono::duration<double, std::milli>(loadEnd - loadBegin).count() << " ms\n";
+    } else {
+        // Ropes hanging from their first node, spread across the top of the box.
+        const float delta = 15.0f;
+        for (int l = 0; l < numLines; ++l) {
+            float start[3] = {50.0f + (l % 8) * 480.0f, sim.params.height - 50.0f - (l / 8) * 40.0f, 0.0f};
+            Line *line = sim.addLine(delta, nodesPerLine, start);
+            line->root().setFixed(true);
+        }
+    }
+
+    sim.params.solverMode = static_cast<SolverMode>(solverMode);
+    sim.params.longRangeAttachments = attachments;
+    if (compliance > 0.0f) sim.setCompliance(compliance);
+
+    TrajectoryRecorder recorder(recordEvery);
+    if (recordPath && !recorder.open(recordPath)) return 1;
+
+    const long long nodes = sim.nodeCount();
+    long long lineSweeps = 0, solvedLines = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; ++s) {
+        sim.step();
+        recorder.capture(sim);
+        lineSweeps += sim.solverStats().lineSweeps;
+        solvedLines += sim.solverStats().lines;
+    }
+    auto end = std::chrono::steady_clock::now();
+    recorder.close();
+
+    double seconds = std::chrono::duration<double>(end - begin).count();
+    double nodeSteps = static_cast<double>(nodes) * steps;
+    std::cout << "integration kernel: " << integrateKernelName() << "\n";
+    std::cout << "lines: " << numLines << "  nodes: " << nodes << "  steps: " << steps << "\n";
+    std::cout << "elapsed: " << seconds << " s  ("
+              << seconds * 1e3 / steps << " ms/step)\n";
+    std::cout << "throughput: " << (seconds > 0.0 ? nodeSteps / seconds : 0.0) << " node-steps/sec\n";
+    const PoolStats &nodePool = sim.particles.stats();
+    const PoolStats &linePool = Line::poolStats();
+    std::cout << "node pool: " << nodePool.live << " live / " << nodePool.capacity
+              << " capacity (high water " << nodePool.highWater << ")\n";
+    std::cout << "line pool: " << linePool.live << " live / " << linePool.capacity
+              << " capacity (high water " << linePool.highWater << ")\n";
+    std::cout << "sleeping lines: " << sim.sleepingLineCount() << " / " << sim.lines.size() << "\n";
+    const SolverStats &solver = sim.solverStats();
+    std::cout << "solver: " << solverModeName(sim.params.solverMode) << "\n";
+    std::cout << "constraint sweeps per line: " << (solvedLines > 0 ? double(lineSweeps) / solvedLines : 0.0)
+              << " average (cap " << sim.params.iterations << ")\n";
+    std::cout << "last step solver: " << solver.sweeps << " sweeps, " << solver.convergedLines << " / "
+              << solver.lines << " lines converged, stretch max " << solver.maxStretch
+              << " rms " << solver.rmsStretch << (solver.budgetExhausted ? " (budget exhausted)" : "")
+              << ", " << solver.attachments << " long-range attachments\n";
+    std::cout << "last step collision pairs: " << sim.broadPhaseStats().candidatePairs
+              << " tested, " << sim.broadPhaseStats().skippedPairs() << " skipped\n";
+
+    if (sim.jobs) {
+        std::vector<WorkerStats> workers = jobs.stats();
+        std::cout << "workers: " << jobs.threadCount() << "  parallel time: "
+                  << jobs.parallelSeconds() * 1e3 << " ms\n";
+        for (int w = 0; w < jobs.threadCount(); ++w) {
+            std::cout << "  worker " << w << ": " << workers[w].jobs << " jobs, "
+                      << workers[w].steals << " stolen, "
+                      << jobs.utilisation(w) * 100.0 << "% busy\n";
+        }
+    }
+
+    if (recordPath) {
+        RecorderStats rs = recorder.stats();
+        std::cout << "trajectory: " << rs.framesWritten << " frames, " << rs.bytesWritten
+                  << " bytes written, " << rs.framesDropped << " dropped\n";
+    }
+
+    std::cout << "state hash: " << std::hex << std::setw(16) << std::setfill('0') << sim.stateHash()
+              << std::dec << "\n";
+
+    if (savePath && !saveSnapshot(sim, savePath)) return 1;
+    return 0;
+}
@@ -17,29 +17,57 @@
 #include "backends/imgui_impl_opengl3.h"
 
 #include <vector>
+#include <chrono>
 #include <cmath>
 #include <iostream>
+#include <cstddef>
 #include <cstring>
+#include <deque>
 #include <limits>
 #include <string>
 #include <random>
+#include <algorithm>
 
 
-#include "Line.h"
+#include "SimulationThread.h"
 
 #define WIDTH 800
 #define HEIGHT 600
 #define BALL_QUALITY 20
-#define BALL_RADIUS 10.0f
-#define DT 0.1f
-#define GRAVITY -10.0f
-#define DAMPING 0.999f
 #define PICK_RADIUS 15.0f
+#define SNAPSHOT_PATH "world.vsnap"
+#define TRAJECTORY_PATH "world.vtraj"
+#define LINE_RING_FRAMES 3
 
 // Globals
 GLuint circleVBO = 0, circleVAO = 0;
-GLuint lineVAO = 0, lineVBO = 0; // reused dynamic buffer for lines
+GLuint lineVAO = 0, lineVBO = 0; // ring of LINE_RING_FRAMES regions holding every rope's vertices
+GLuint dragVAO = 0, dragVBO = 0;  // two-vertex drag preview
+GLuint ballInstanceVBO = 0;       // per-node centre + colour, attached to circleVAO
 GLuint shaderProgram = 0;
+GLuint ballProgram = 0;
+
+// Uniform locations, looked up once after linking.
+struct {
+    GLint projection = -1, model = -1, color = -1;
+} gFlatUniforms;
+struct {
+    GLint projection = -1, radius = -1;
+} gBallUniforms;
+
+struct BallInstance {
+    glm::vec2 center;
+    glm::vec3 color;
+};
+std::vector<BallInstance> gBallInstances;
+
+// Line ring state: the frame writing region r waits on fence r, set when
+// the draw that last read that region was submitted.
+GLsizeiptr gLineRegionBytes = 0;
+int gLineRegion = 0;
+GLsync gLineFences[LINE_RING_FRAMES] = {};
+std::vector<GLint> gLineFirsts;
+std::vector<GLsizei> gLineCounts;
 
 GLFWwindow* windowPtr = nullptr;
 
@@ -50,8 +78,36 @@ int winHeight = HEIGHT;
 
 glm::mat4 gProjection(1.0f);
 
-std::vector<Line*> lines;
+// Physics runs on its own thread; everything below reads the snapshots it
+// publishes and posts edits back to it.
+SimulationThread simThread;
+
+// The command queue only fills if the simulation thread falls far behind.
+// The render thread never waits for it: commands that don't fit wait here,
+// in order, and are re-posted at the start of the next frame.
+std::deque<SimCommand> gPendingCommands;
+
+static void postCommand(const SimCommand& command) {
+    if (gPendingCommands.empty() && simThread.post(command)) return;
+    gPendingCommands.push_back(command);
+}
+
+static void flushPendingCommands() {
+    while (!gPendingCommands.empty() && simThread.post(gPendingCommands.front())) {
+        gPendingCommands.pop_front();
+    }
+}
+Profiler profiler;
+// Physics phases, one sample per simulation update rather than per frame.
+Profiler physicsProfiler;
 bool paused = false;
+int substeps = SimulationParams().substeps;
+int maxCatchUp = FixedTimestep().maxStepsPerFrame;
+int solverMode = SimulationParams().solverMode;
+float compliance = SimulationParams().compliance;
+bool attachments = SimulationParams().longRangeAttachments;
+bool recording = false;
+bool vsync = true;
 
 enum OPTIONS {
     DRAGGING,
@@ -65,9 +121,9 @@ OPTIONS m_Mode = OPTIONS::TOGGLING;
 bool isDragging = false;
 glm::vec2 dragStart(0.0f);
 glm::vec2 dragEnd(0.0f);
-Line* dragLine = nullptr;  // line on which drag started
-Node* dragNodeA = nullptr;
-Node* dragNodeB = nullptr;
+uint32_t dragLine = 0;      // id of the line on which drag started
+int dragNode = -1;          // picked node within dragLine, -1 when none
+bool dragNodeFixed = false; // fixed nodes move the whole line on release
 float gInsertDelta = 20.0f;   // default spacing between nodes
 int   gInsertCount = 10;      // number of nodes to insert
 
@@ -99,6 +155,34 @@ void main() {
 }
 )GLSL";
 
+// One unit-circle fan per instance, placed by the per-instance centre.
+static const char* kBallVertexShader = R"GLSL(
+#version 330 core
+layout(location = 0) in vec2 aPos;
+layout(location = 1) in vec2 aCenter;
+layout(location = 2) in vec3 aColor;
+
+uniform mat4 uProjection;
+uniform float uRadius;
+
+out vec3 vColor;
+
+void main() {
+    vColor = aColor;
+    gl_Position = uProjection * vec4(aCenter + aPos * uRadius, 0.0, 1.0);
+}
+)GLSL";
+
+static const char* kBallFragmentShader = R"GLSL(
+#version 330 core
+in vec3 vColor;
+out vec4 FragColor;
+
+void main() {
+    FragColor = vec4(vColor, 1.0);
+}
+)GLSL";
+
 GLuint compileShader(GLenum type, const char* src) {
     GLuint s = glCreateShader(type);
     glShaderSource(s, 1, &src, nullptr);
@@ -150,25 +234,25 @@ glm::vec2 screenToWorld(GLFWwindow* window, double xpos, double ypos) {
     return glm::vec2(fbX, (float)(fH) - fbY);
 }
 
-float distSquared(const float* pos, const glm::vec2& point2D) {
-    float dx = pos[0] - point2D.x;
-    float dy = pos[1] - point2D.y;
+float distSquared(const RenderSnapshot& snap, int i, const glm::vec2& point2D) {
+    float dx = snap.x[i] - point2D.x;
+    float dy = snap.y[i] - point2D.y;
     return dx*dx + dy*dy;
 }
 
-Node* findClosestNode(Line& line, const glm::vec2& clickPos, float maxDist) {
-    Node* curr = line.root;
-    Node* closest = nullptr;
+// Index into the snapshot arrays of the node of `line` closest to clickPos,
+// or -1 if none lies within maxDist.
+int findClosestNode(const RenderSnapshot& snap, const RenderLine& line, const glm::vec2& clickPos, float maxDist) {
+    int closest = -1;
     float maxDistSq = maxDist * maxDist;
     float bestDistSq = maxDistSq;
 
-    while (curr) {
-        float dSq = distSquared(curr->position, clickPos);
+    for (int i = line.first; i < line.first + line.count; ++i) {
+        float dSq = distSquared(snap, i, clickPos);
         if (dSq < bestDistSq) {
             bestDistSq = dSq;
-            closest = curr;
+            closest = i;
         }
-        curr = curr->getNext();
     }
     return closest;
 }
@@ -190,166 +274,59 @@ float pointSegmentDistSq(const glm::vec2& p, const glm::vec2& v, const glm::vec2
 }
 
 struct LineSegmentHit {
-    Line* line = nullptr;
-    Node* nodeA = nullptr;
-    Node* nodeB = nullptr;
+    const RenderLine* line = nullptr;
+    int segment = -1;   // index of the segment's first node within line
     float distSq = std::numeric_limits<float>::max();
 };
 
-LineSegmentHit findClosestSegmentInAllLines(const glm::vec2& clickPos, float maxDist) {
+LineSegmentHit findClosestSegmentInAllLines(const RenderSnapshot& snap, const glm::vec2& clickPos, float maxDist) {
     LineSegmentHit hit;
     float maxDistSq = maxDist * maxDist;
 
-    for (Line* line : lines) {
-        Node* curr = line->root;
-        while (curr && curr->getNext()) {
-            glm::vec2 v(curr->position[0], curr->position[1]);
-            glm::vec2 w(curr->getNext()->position[0], curr->getNext()->position[1]);
+    for (const RenderLine& line : snap.lines) {
+        for (int i = 0; i + 1 < line.count; ++i) {
+            int a = line.first + i;
+            glm::vec2 v(snap.x[a], snap.y[a]);
+            glm::vec2 w(snap.x[a + 1], snap.y[a + 1]);
             float distSq = pointSegmentDistSq(clickPos, v, w);
             if (distSq < maxDistSq && distSq < hit.distSq) {
-                hit.line = line;
-                hit.nodeA = curr;
-                hit.nodeB = curr->getNext();
+                hit.line = &line;
+                hit.segment = i;
                 hit.distSq = distSq;
             }
-            curr = curr->getNext();
         }
     }
     return hit;
 }
 
 // ---------------------------
-// Physics helpers (unchanged logic)
+// Rendering (modern GL)
 // ---------------------------
-void enforceMaxDistance(Node* a, Node* b, float delta) {
-    float dir[3];
-    float distSq = 0.0f;
-
-    for (int i = 0; i < 3; ++i) {
-        dir[i] = b->position[i] - a->position[i];
-        distSq += dir[i] * dir[i];
-    }
-
-    float dist = sqrtf(distSq);
-    if (dist < 1e-6f) return;
-
-    float diff = (dist - delta) / dist;
-    float offset[3] = {
-        dir[0] * 0.5f * diff,
-        dir[1] * 0.5f * diff,
-        dir[2] * 0.5f * diff
-    };
-
-    if (!a->fixed && !b->fixed) {
-        for (int i = 0; i < 3; ++i) {
-            a->position[i] += offset[i];
-            b->position[i] -= offset[i];
-        }
-    } else if (!a->fixed) {
-        for (int i = 0; i < 3; ++i)
-            a->position[i] += offset[i] * 2.0f;
-    } else if (!b->fixed) {
-        for (int i = 0; i < 3; ++i)
-            b->position[i] -= offset[i] * 2.0f;
-    }
-}
-
-void resolveNodeCollision(Node* a, Node* b, float radiusSum) {
-    float dir[3];
-    float distSq = 0.0f;
-
-    for (int i = 0; i < 3; ++i) {
-        dir[i] = b->position[i] - a->position[i];
-        distSq += dir[i] * dir[i];
-    }
-
-    float minDist = radiusSum;
-    float minDistSq = minDist * minDist;
-
-    if (distSq >= minDistSq || distSq < 1e-6f) return;
-
-    float dist = sqrtf(distSq);
-    float overlap = minDist - dist;
-    float offsetAmount = overlap / dist * 0.5f;
-
-    float offset[3];
-    for (int i = 0; i < 3; ++i)
-        offset[i] = dir[i] * offsetAmount;
-
-    if (!a->fixed && !b->fixed) {
-        for (int i = 0; i < 3; ++i) {
-            a->position[i] -= offset[i];
-            b->position[i] += offset[i];
-        }
-    } else if (!a->fixed) {
-        for (int i = 0; i < 3; ++i)
-            a->position[i] -= offset[i] * 2.0f;
-    } else if (!b->fixed) {
-        for (int i = 0; i < 3; ++i)
-            b->position[i] += offset[i] * 2.0f;
-    }
-}
-
-void enforceWallCollision(Node* node, float radius) {
-    if (node->fixed) return;
-
-    if (node->position[0] < radius)
-        node->position[0] = radius;
-    else if (node->position[0] > fbWidth - radius)
-        node->position[0] = fbWidth - radius;
-
-    if (node->position[1] < radius)
-        node->position[1] = radius;
-    else if (node->position[1] > fbHeight - radius)
-        node->position[1] = fbHeight - radius;
-}
-
-void applyGravity(Line& line, float gravity = GRAVITY, float timeStep = DT) {
-    std::vector<Node*> nodeList;
-    Node* curr = line.root;
-    while (curr) {
-        nodeList.push_back(curr);
-        curr = curr->getNext();
-    }
-
-    for (Node* node : nodeList) {
-        if (node->fixed) continue;
-        if (node == dragNodeA) {
-            double xpos, ypos;
-            glfwGetCursorPos(windowPtr, &xpos, &ypos);
-            glm::vec2 p = screenToWorld(windowPtr, xpos, ypos);
-            node->position[0] = p[0];
-            node->position[1] = p[1];
-            continue;
-        };
-
-        float* pos = node->position;
-        float* prev = node->previousPos;
-        float temp[3] = { pos[0], pos[1], pos[2] };
-
-        pos[0] += (pos[0] - prev[0]) * DAMPING;
-        pos[1] += (pos[1] - prev[1]) * DAMPING + gravity * timeStep * timeStep;
-        pos[2] += (pos[2] - prev[2]) * DAMPING;
+void createPrograms() {
+    shaderProgram = createProgram(kVertexShader, kFragmentShader);
+    gFlatUniforms.projection = glGetUniformLocation(shaderProgram, "uProjection");
+    gFlatUniforms.model = glGetUniformLocation(shaderProgram, "uModel");
+    gFlatUniforms.color = glGetUniformLocation(shaderProgram, "uColor");
 
-        memcpy(prev, temp, sizeof(float) * 3);
-    }
+    ballProgram = createProgram(kBallVertexShader, kBallFragmentShader);
+    gBallUniforms.projection = glGetUniformLocation(ballProgram, "uProjection");
+    gBallUniforms.radius = glGetUniformLocation(ballProgram, "uRadius");
 
-    const int iterations = 8;
-    for (int it = 0; it < iterations; ++it) {
-        for (size_t i = 0; i + 1 < nodeList.size(); ++i) {
-            enforceMaxDistance(nodeList[i], nodeList[i + 1], line.delta);
-        }
-    }
+    // Neither changes per draw: lines are already in world space.
+    glm::mat4 identity(1.0f);
+    glUseProgram(shaderProgram);
+    glUniformMatrix4fv(gFlatUniforms.model, 1, GL_FALSE, glm::value_ptr(identity));
+    glUseProgram(ballProgram);
+    glUniform1f(gBallUniforms.radius, BALL_RADIUS);
+    glUseProgram(0);
 }
 
-// ---------------------------
-// Rendering (modern GL)
-// ---------------------------
 void updateProjection() {
     gProjection = glm::ortho(0.0f, (float)fbWidth, 0.0f, (float)fbHeight, -1.0f, 1.0f);
     glUseProgram(shaderProgram);
-    GLint locProj = glGetUniformLocation(shaderProgram, "uProjection");
-    glUniformMatrix4fv(locProj, 1, GL_FALSE, glm::value_ptr(gProjection));
+    glUniformMatrix4fv(gFlatUniforms.projection, 1, GL_FALSE, glm::value_ptr(gProjection));
+    glUseProgram(ballProgram);
+    glUniformMatrix4fv(gBallUniforms.projection, 1, GL_FALSE, glm::value_ptr(gProjection));
     glUseProgram(0);
 }
 
@@ -381,137 +358,156 @@ void createUnitCircle() {
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
 
+    // Per-instance attributes, refilled each frame by renderBalls()
+    glGenBuffers(1, &ballInstanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, ballInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(BallInstance), (void*)offsetof(BallInstance, center));
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(BallInstance), (void*)offsetof(BallInstance, color));
+    glVertexAttribDivisor(2, 1);
+
     glBindVertexArray(0);
 }
 
-// Reusable dynamic line VAO/VBO
+// Streaming line ring VAO/VBO, plus a small buffer for the drag preview
 void createLineBuffer() {
     glGenVertexArrays(1, &lineVAO);
     glGenBuffers(1, &lineVBO);
 
     glBindVertexArray(lineVAO);
     glBindBuffer(GL_ARRAY_BUFFER, lineVBO);
-    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+
+    glGenVertexArrays(1, &dragVAO);
+    glGenBuffers(1, &dragVBO);
+    glBindVertexArray(dragVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, dragVBO);
+    glBufferData(GL_ARRAY_BUFFER, 2 * sizeof(glm::vec2), nullptr, GL_DYNAMIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
     glBindVertexArray(0);
 }
 
-void drawBall(const glm::vec2& pos, const glm::vec3& color) {
-    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(pos, 0.0f));
-    model = glm::scale(model, glm::vec3(BALL_RADIUS, BALL_RADIUS, 1.0f));
+void releaseLineFences() {
+    for (GLsync& fence : gLineFences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
 
-    glUseProgram(shaderProgram);
-    GLint locModel = glGetUniformLocation(shaderProgram, "uModel");
-    GLint locColor = glGetUniformLocation(shaderProgram, "uColor");
-    glUniformMatrix4fv(locModel, 1, GL_FALSE, glm::value_ptr(model));
-    glUniform3fv(locColor, 1, glm::value_ptr(color));
+// Every rope as one vertex stream in the next ring region, drawn with a
+// single glMultiDrawArrays. The region is written through an unsynchronized
+// map, so the driver never copies or stalls; the fence only blocks if the
+// GPU is still LINE_RING_FRAMES frames behind.
+void renderLines(const RenderSnapshot& snap, float alpha) {
+    {
+        ProfileScope scope(&profiler, PHASE_UPLOAD);
+        const GLsizeiptr bytes = snap.nodeCount() * (GLsizeiptr)sizeof(glm::vec2);
+        if (bytes == 0) return;
+
+        glBindBuffer(GL_ARRAY_BUFFER, lineVBO);
+        if (bytes > gLineRegionBytes) {
+            // Grow geometrically; the old storage is orphaned, so its fences go too.
+            releaseLineFences();
+            gLineRegionBytes = std::max(bytes, 2 * gLineRegionBytes);
+            glBufferData(GL_ARRAY_BUFFER, gLineRegionBytes * LINE_RING_FRAMES, nullptr, GL_STREAM_DRAW);
+            gLineRegion = 0;
+        }
 
-    glBindVertexArray(circleVAO);
-    glDrawArrays(GL_TRIANGLE_FAN, 0, BALL_QUALITY + 2);
-    glBindVertexArray(0);
-}
+        GLsync& fence = gLineFences[gLineRegion];
+        if (fence) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
 
-void renderLine(Line& line) {
-    // Gather vertices
-    std::vector<glm::vec2> vertices;
-    Node* curr = line.root;
-    while (curr) {
-        vertices.emplace_back(curr->position[0], curr->position[1]);
-        curr = curr->getNext();
+        const GLintptr regionStart = gLineRegion * gLineRegionBytes;
+        glm::vec2* dst = (glm::vec2*)glMapBufferRange(GL_ARRAY_BUFFER, regionStart, bytes,
+                                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                                                      GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!dst) return;
+
+        gLineFirsts.clear();
+        gLineCounts.clear();
+        GLint vertex = (GLint)(regionStart / sizeof(glm::vec2));
+        for (const RenderLine& line : snap.lines) {
+            if (line.count < 2) continue;
+            gLineFirsts.push_back(vertex);
+            gLineCounts.push_back(line.count);
+            for (int i = line.first; i < line.first + line.count; ++i) {
+                *dst++ = glm::mix(glm::vec2(snap.lastX[i], snap.lastY[i]), glm::vec2(snap.x[i], snap.y[i]), alpha);
+            }
+            vertex += line.count;
+        }
+        glUnmapBuffer(GL_ARRAY_BUFFER);
     }
-    if (vertices.empty()) return;
-
-    // Upload to dynamic buffer
-    glBindVertexArray(lineVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, lineVBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), vertices.data(), GL_DYNAMIC_DRAW);
 
-    // Render line strip
+    ProfileScope scope(&profiler, PHASE_DRAW);
     glUseProgram(shaderProgram);
-    glm::mat4 model(1.0f);
-    GLint locModel = glGetUniformLocation(shaderProgram, "uModel");
-    GLint locColor = glGetUniformLocation(shaderProgram, "uColor");
-    glUniformMatrix4fv(locModel, 1, GL_FALSE, glm::value_ptr(model));
-    glUniform3f(locColor, 0.0f, 1.0f, 0.0f);
+    glUniform3f(gFlatUniforms.color, 0.0f, 1.0f, 0.0f);
+    glBindVertexArray(lineVAO);
+    glMultiDrawArrays(GL_LINE_STRIP, gLineFirsts.data(), gLineCounts.data(), (GLsizei)gLineFirsts.size());
+    glBindVertexArray(0);
 
-    glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)vertices.size());
+    gLineFences[gLineRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    gLineRegion = (gLineRegion + 1) % LINE_RING_FRAMES;
+}
 
-    glBindVertexArray(0);
+// Every node of every line in one instanced draw.
+void renderBalls(const RenderSnapshot& snap, float alpha) {
+    {
+        ProfileScope scope(&profiler, PHASE_UPLOAD);
+        gBallInstances.clear();
+        for (int i = 0; i < snap.nodeCount(); ++i) {
+            glm::vec3 color = snap.fixed[i] ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+            glm::vec2 center = glm::mix(glm::vec2(snap.lastX[i], snap.lastY[i]), glm::vec2(snap.x[i], snap.y[i]), alpha);
+            gBallInstances.push_back({center, color});
+        }
+        if (gBallInstances.empty()) return;
 
-    // Draw balls for nodes
-    curr = line.root;
-    while (curr) {
-        glm::vec3 color = curr->fixed ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
-        drawBall(glm::vec2(curr->position[0], curr->position[1]), color);
-        curr = curr->getNext();
+        // Orphan last frame's storage so the upload doesn't wait on it.
+        GLsizeiptr bytes = gBallInstances.size() * sizeof(BallInstance);
+        glBindBuffer(GL_ARRAY_BUFFER, ballInstanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, gBallInstances.data());
     }
+
+    ProfileScope scope(&profiler, PHASE_DRAW);
+    glUseProgram(ballProgram);
+    glBindVertexArray(circleVAO);
+    glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, BALL_QUALITY + 2, (GLsizei)gBallInstances.size());
+    glBindVertexArray(0);
 }
 
 // Render drag line (preview)
 void renderDragLine() {
     if (!isDragging) return;
-    if (!dragNodeA->fixed) return;
+    if (dragNode < 0 || !dragNodeFixed) return;
     glm::vec2 verts[2] = { dragStart, dragEnd };
 
-    glBindVertexArray(lineVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, lineVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, dragVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(verts), verts);
 
     glUseProgram(shaderProgram);
-    glm::mat4 model(1.0f);
-    GLint locModel = glGetUniformLocation(shaderProgram, "uModel");
-    GLint locColor = glGetUniformLocation(shaderProgram, "uColor");
-    glUniformMatrix4fv(locModel, 1, GL_FALSE, glm::value_ptr(model));
-    glUniform3f(locColor, 1.0f, 1.0f, 0.0f);
+    glUniform3f(gFlatUniforms.color, 1.0f, 1.0f, 0.0f);
 
-    glBindVertexArray(lineVAO);
+    glBindVertexArray(dragVAO);
     glDrawArrays(GL_LINES, 0, 2);
     glBindVertexArray(0);
 }
 
-// ---------------------------
-// Line creation
-// ---------------------------
-void createNewLine(const glm::vec2& start, const glm::vec2& end, int numPoints) {
-    if (numPoints < 2) {
-        std::cout << "Number of nodes must be >= 2.\n";
-        return;
-    }
-    Line* newLine = new Line();
-
-    float dir[3] = { (end.x - start.x) / (numPoints - 1), (end.y - start.y) / (numPoints - 1), 0.f };
-    float pos[3] = { start.x, start.y, 0.f };
-
-    newLine->root = new Node(pos, nullptr);
-    Node* prev = newLine->root;
-
-    for (int i = 1; i < numPoints; ++i) {
-        pos[0] = start.x + dir[0] * i;
-        pos[1] = start.y + dir[1] * i;
-        pos[2] = 0.f;
-        Node* nextNode = new Node(pos, prev);
-        prev->setNext(nextNode);
-        prev = nextNode;
-    }
-    newLine->end = prev;
-
-    float delta = glm::distance(
-        glm::vec2(newLine->root->position[0], newLine->root->position[1]),
-        glm::vec2(newLine->root->getNext()->position[0], newLine->root->getNext()->position[1])
-    );
-    newLine->delta = delta;
-
-    lines.push_back(newLine);
-    std::cout << "Created new line with " << numPoints << " nodes.\n";
-}
-
 // ---------------------------
 // Input callbacks
 // ---------------------------
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
         paused = !paused;
+        postCommand({CMD_PAUSE, 0, 0, 0.0f, 0.0f, 0.0f, paused});
         std::cout << (paused ? "Paused" : "Unpaused") << " simulation.\n";
     }
 
@@ -546,25 +542,24 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
         ImGuiIO& io = ImGui::GetIO();
         if (io.WantCaptureMouse)
             return;
+        const RenderSnapshot& snap = simThread.latest();
         if (m_Mode == OPTIONS::TOGGLING) {
-            for (Line* line : lines) {
-                Node* clickedNode = findClosestNode(*line, clickPos, PICK_RADIUS);
-                if (clickedNode) {
-                    float dSq = distSquared(clickedNode->position, clickPos);
-                    if (dSq <= PICK_RADIUS * PICK_RADIUS) {
-                        clickedNode->setFixed(!clickedNode->fixed);
-                        std::cout << "Toggled node fixed state to " << clickedNode->fixed << std::endl;
-                        return;
-                    }
+            for (const RenderLine& line : snap.lines) {
+                int clicked = findClosestNode(snap, line, clickPos, PICK_RADIUS);
+                if (clicked >= 0) {
+                    postCommand({CMD_TOGGLE_FIXED, line.id, clicked - line.first});
+                    std::cout << "Toggled node fixed state to " << !snap.fixed[clicked] << std::endl;
+                    return;
                 }
             }
         } else if (m_Mode == OPTIONS::DRAGGING) {
-            for (Line* line : lines) {
-                Node* clickedNode = findClosestNode(*line, clickPos, PICK_RADIUS);
-                if (clickedNode) {
+            for (const RenderLine& line : snap.lines) {
+                int clicked = findClosestNode(snap, line, clickPos, PICK_RADIUS);
+                if (clicked >= 0) {
                     isDragging = true;
-                    dragNodeA = clickedNode;
-                    dragLine = line;
+                    dragLine = line.id;
+                    dragNode = clicked - line.first;
+                    dragNodeFixed = snap.fixed[clicked];
                     dragStart = clickPos;
                     dragEnd = clickPos;
                     std::cout << "Started dragging from node.\n";
@@ -572,76 +567,45 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
                 }
             }
 
-            auto hit = findClosestSegmentInAllLines(clickPos, PICK_RADIUS);
-            if (hit.line && hit.nodeA && hit.nodeB) {
+            auto hit = findClosestSegmentInAllLines(snap, clickPos, PICK_RADIUS);
+            if (hit.line) {
                 isDragging = true;
                 dragStart = clickPos;
                 dragEnd = clickPos;
-                dragLine = hit.line;
-                dragNodeA = hit.nodeA;
-                dragNodeB = hit.nodeB;
+                dragLine = hit.line->id;
+                dragNode = hit.segment;
+                dragNodeFixed = snap.fixed[hit.line->first + hit.segment];
                 std::cout << "Started dragging to move line.\n";
             }
         } else if (m_Mode == OPTIONS::CUTTING) {
-            auto hit = findClosestSegmentInAllLines(clickPos, PICK_RADIUS);
-            if (hit.line && hit.nodeA && hit.nodeB) {
-                hit.nodeA->next = nullptr;
-                Line* newLine = new Line(hit.line->delta, 0, hit.nodeB->position);
-                lines.push_back(newLine);
-                newLine->root = hit.nodeB;
-                newLine->root->setFixed(true);
+            auto hit = findClosestSegmentInAllLines(snap, clickPos, PICK_RADIUS);
+            if (hit.line) {
+                postCommand({CMD_CUT, hit.line->id, hit.segment + 1});
             }
         } else if (m_Mode == OPTIONS::INSERTING) {
-            float* starting = new float[3]{ clickPos.x, clickPos.y, 0.0f };
-
-            int random = dis(gen);
-            Line* newLine = new Line(gInsertDelta, gInsertCount, starting);
-            lines.push_back(newLine);
-            Node* root = newLine->root;
-            int i = 0;
-            while (i != random) {
-                root = root->next;
-                i++;
-            };
-            root->setFixed(true);
+            postCommand({CMD_INSERT, 0, dis(gen), clickPos.x, clickPos.y, gInsertDelta, gInsertCount});
         }
         else if (m_Mode == OPTIONS::DELETING) {
-            auto hit = findClosestSegmentInAllLines(clickPos, PICK_RADIUS);
-            auto it = std::find(lines.begin(), lines.end(), hit.line);
-            if (it != lines.end()) {
-                delete *it;  // Free the memory if you allocated it with 'new'
-                lines.erase(it);  // Remove from vector
+            auto hit = findClosestSegmentInAllLines(snap, clickPos, PICK_RADIUS);
+            if (hit.line) {
+                if (dragLine == hit.line->id) {
+                    isDragging = false;
+                    dragNode = -1;
+                }
+                postCommand({CMD_DELETE, hit.line->id});
             }
         }
 
     } else if (action == GLFW_RELEASE) {
-        if (isDragging && m_Mode == OPTIONS::DRAGGING) {
-            isDragging = false;
+        if (isDragging && m_Mode == OPTIONS::DRAGGING && dragNode >= 0 && dragNodeFixed) {
             glm::vec2 delta = dragEnd - dragStart;
-            Node* root = nullptr;
-            if (dragNodeA->fixed) {
-                root = dragNodeA;
-                while (root->prev) {
-                    root = root->prev;
-                }
-            }
-            while (root) {
-                root->position[0] += delta.x;
-                root->position[1] += delta.y;
-
-                // Important: also move previousPos to match
-                root->previousPos[0] += delta.x;
-                root->previousPos[1] += delta.y;
-
-                root = root->next;
-            }
-
-            dragLine = nullptr;
-            dragNodeA = nullptr;
-
-        } else {
-            isDragging = false;
+            postCommand({CMD_MOVE_LINE, dragLine, 0, delta.x, delta.y});
+        }
+        if (isDragging) {
+            simThread.endDrag();
         }
+        isDragging = false;
+        dragNode = -1;
     }
 }
 
@@ -678,7 +642,7 @@ int main() {
         return -1;
     }
     glfwMakeContextCurrent(windowPtr);
-    glfwSwapInterval(1); // vsync
+    glfwSwapInterval(vsync ? 1 : 0);
 
     glewExperimental = GL_TRUE;
     GLenum glewStatus = glewInit();
@@ -699,8 +663,8 @@ int main() {
     // Pass GLSL version string to backend (330 core)
     ImGui_ImplOpenGL3_Init("#version 330 core");
 
-    // Create shader
-    shaderProgram = createProgram(kVertexShader, kFragmentShader);
+    // Create shaders
+    createPrograms();
 
     // Framebuffer sizes and projection
     glfwGetWindowSize(windowPtr, &winWidth, &winHeight);
@@ -726,15 +690,22 @@ int main() {
 
     // Initial line (same logic as your original)
     float start[3] = {100.0f, 500.0f, 0.0f};
-    Line* line1 = new Line(400, 14, start);
-    if (line1->root && line1->root->getNext() && line1->root->getNext()->getNext() &&
-        line1->root->getNext()->getNext()->getNext() && line1->root->getNext()->getNext()->getNext()->getNext()) {
-        line1->root->getNext()->getNext()->getNext()->getNext()->setFixed(true);
+    Simulation& sim = simThread.simulation();
+    sim.params.width = (float)fbWidth;
+    sim.params.height = (float)fbHeight;
+    Line* line1 = sim.addLine(400.0f / 13, 14, start);
+    if (line1->size() > 4) {
+        line1->getNode(4).setFixed(true);
     }
-    lines.push_back(line1);
+    simThread.start();
 
     // Main loop
+    int boundsWidth = fbWidth, boundsHeight = fbHeight;
+    uint64_t lastPhaseSequence = 0;
     while (!glfwWindowShouldClose(windowPtr)) {
+        profiler.beginFrame();
+        flushPendingCommands();
+
         // ImGui new frame
         glfwPollEvents();
         ImGui_ImplOpenGL3_NewFrame();
@@ -754,7 +725,91 @@ int main() {
             case OPTIONS::TOGGLING:  modeName = "TOGGLING"; break;
         }
         ImGui::Text("Current Mode: %s", modeName);
-        ImGui::Checkbox("Paused", &paused);
+        const RenderSnapshot& snap = simThread.latest();
+        if (ImGui::Checkbox("Paused", &paused)) {
+            postCommand({CMD_PAUSE, 0, 0, 0.0f, 0.0f, 0.0f, paused});
+        }
+        if (ImGui::Checkbox("VSync", &vsync)) {
+            glfwSwapInterval(vsync ? 1 : 0);
+        }
+        if (ImGui::SliderInt("Substeps", &substeps, 1, 16)) {
+            postCommand({CMD_SUBSTEPS, 0, 0, 0.0f, 0.0f, 0.0f, substeps});
+        }
+        if (ImGui::SliderInt("Max catch-up", &maxCatchUp, 1, 64)) {
+            postCommand({CMD_MAX_CATCH_UP, 0, 0, 0.0f, 0.0f, 0.0f, maxCatchUp});
+        }
+        const char* solverNames[SOLVER_MODE_COUNT];
+        for (int mode = 0; mode < SOLVER_MODE_COUNT; ++mode) {
+            solverNames[mode] = solverModeName(static_cast<SolverMode>(mode));
+        }
+        if (ImGui::Combo("Solver", &solverMode, solverNames, SOLVER_MODE_COUNT)) {
+            postCommand({CMD_SOLVER, 0, 0, 0.0f, 0.0f, 0.0f, solverMode});
+        }
+        if (solverMode == SOLVER_XPBD &&
+            ImGui::SliderFloat("Compliance", &compliance, 0.0f, 0.01f, "%.5f", ImGuiSliderFlags_Logarithmic)) {
+            postCommand({CMD_COMPLIANCE, 0, 0, compliance});
+        }
+        if (ImGui::Checkbox("Long-range attachments", &attachments)) {
+            postCommand({CMD_ATTACHMENTS, 0, 0, 0.0f, 0.0f, 0.0f, attachments});
+        }
+        ImGui::Text("Physics: %.0f steps/s, %d last update (dropped %lld)",
+                    snap.stepsPerSecond, snap.lastSteps, snap.droppedSteps);
+        const BroadPhaseStats& bp = snap.broadPhase;
+        ImGui::Text("Collision pairs: %lld tested, %lld skipped (of %lld)",
+                    bp.candidatePairs, bp.skippedPairs(), bp.bruteForcePairs);
+        const SolverStats& solver = snap.solver;
+        ImGui::Text("Constraint sweeps: %d max, %.1f per line (%d / %d converged)",
+                    solver.sweeps, solver.lines > 0 ? (float)solver.lineSweeps / solver.lines : 0.0f,
+                    solver.convergedLines, solver.lines);
+        ImGui::Text("Stretch: max %.2f%%, rms %.2f%% (%d attachments)",
+                    solver.maxStretch * 100.0f, solver.rmsStretch * 100.0f, solver.attachments);
+        ImGui::Text("Sleeping lines: %d / %d", snap.sleepingLines, (int)snap.lines.size());
+        if (ImGui::Button("Save snapshot")) {
+            postCommand({CMD_SAVE, 0, 0, 0.0f, 0.0f, 0.0f, 0, SNAPSHOT_PATH});
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Load snapshot")) {
+            isDragging = false;
+            dragNode = -1;
+            postCommand({CMD_LOAD, 0, 0, 0.0f, 0.0f, 0.0f, 0, SNAPSHOT_PATH});
+        }
+        if (ImGui::Checkbox("Record trajectory", &recording)) {
+            postCommand({CMD_RECORD, 0, 0, 0.0f, 0.0f, 0.0f, recording, TRAJECTORY_PATH});
+        }
+        if (snap.recording) {
+            const RecorderStats& rs = snap.recorder;
+            ImGui::Text("%lld frames, %.1f KB written, %lld dropped",
+                        rs.framesWritten, rs.bytesWritten / 1024.0, rs.framesDropped);
+        }
+        if (ImGui::CollapsingHeader("Memory")) {
+            const PoolStats& nodePool = snap.nodePool;
+            const PoolStats& linePool = snap.linePool;
+            ImGui::Text("Nodes: %lld live / %lld capacity (high water %lld)",
+                        nodePool.live, nodePool.capacity, nodePool.highWater);
+            ImGui::Text("Free node ranges: %d (largest %d)",
+                        snap.freeRanges, snap.largestFreeRange);
+            ImGui::Text("Lines: %lld live / %lld capacity (high water %lld)",
+                        linePool.live, linePool.capacity, linePool.highWater);
+        }
+        if (!snap.workerUtilisation.empty() && ImGui::CollapsingHeader("Workers")) {
+            for (int w = 0; w < (int)snap.workerUtilisation.size(); ++w) {
+                ImGui::Text("Worker %d: %5.1f%% busy in parallel phases", w, snap.workerUtilisation[w] * 100.0f);
+            }
+        }
+        if (ImGui::CollapsingHeader("Profiler")) {
+            for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+                ProfilePhase ph = static_cast<ProfilePhase>(phase);
+                const Profiler& source = phase < PHASE_UPLOAD ? physicsProfiler : profiler;
+                PhaseSummary ps = source.summary(ph);
+                ImGui::Text("%-22s %6.3f ms  p50 %6.3f  p95 %6.3f  p99 %6.3f",
+                            profilePhaseName(ph), source.last(ph), ps.p50, ps.p95, ps.p99);
+                ImGui::PushID(phase);
+                ImGui::PlotLines("##history", source.history(ph).data(), source.capacity(),
+                                 source.offset(), nullptr, 0.0f, std::max(ps.p99 * 1.5f, 0.01f),
+                                 ImVec2(0.0f, 30.0f));
+                ImGui::PopID();
+            }
+        }
         if (m_Mode == OPTIONS::INSERTING) {
             ImGui::Separator();
             ImGui::Text("Insert Settings");
@@ -769,82 +824,62 @@ int main() {
 
         glClear(GL_COLOR_BUFFER_BIT);
 
-        // Physics update
-        if (!paused) {
-            for (Line* line : lines) {
-                applyGravity(*line, GRAVITY, DT);
-            }
-
-            for (Line* line : lines) {
-                std::vector<Node*> nodes;
-                Node* curr = line->root;
-                while (curr) {
-                    nodes.push_back(curr);
-                    curr = curr->getNext();
-                }
-                for (size_t i = 0; i < nodes.size(); ++i) {
-                    for (size_t j = i + 2; j < nodes.size(); ++j) {
-                        resolveNodeCollision(nodes[i], nodes[j], BALL_RADIUS * 2.0f);
-                    }
-                }
-            }
-
-            for (size_t i = 0; i < lines.size(); ++i) {
-                std::vector<Node*> nodesA;
-                Node* currA = lines[i]->root;
-                while (currA) {
-                    nodesA.push_back(currA);
-                    currA = currA->getNext();
-                }
-                for (size_t j = i + 1; j < lines.size(); ++j) {
-                    std::vector<Node*> nodesB;
-                    Node* currB = lines[j]->root;
-                    while (currB) {
-                        nodesB.push_back(currB);
-                        currB = currB->getNext();
-                    }
-                    for (Node* nA : nodesA) {
-                        for (Node* nB : nodesB) {
-                            resolveNodeCollision(nA, nB, BALL_RADIUS * 2.0f);
-                        }
-                    }
-                }
-            }
-
-            for (Line* line : lines) {
-                Node* curr = line->root;
-                while (curr) {
-                    enforceWallCollision(curr, BALL_RADIUS);
-                    curr = curr->getNext();
-                }
+        // Physics runs on its own thread: hand it input, then draw its
+        // newest state interpolated to now.
+        if (fbWidth != boundsWidth || fbHeight != boundsHeight) {
+            boundsWidth = fbWidth;
+            boundsHeight = fbHeight;
+            postCommand({CMD_BOUNDS, 0, 0, (float)fbWidth, (float)fbHeight});
+        }
+        if (isDragging && dragNode >= 0 && !dragNodeFixed) {
+            double xpos, ypos;
+            glfwGetCursorPos(windowPtr, &xpos, &ypos);
+            glm::vec2 cursor = screenToWorld(windowPtr, xpos, ypos);
+            simThread.drag(dragLine, dragNode, cursor.x, cursor.y);
+        }
+        // Frames drawn between updates show the same timings again; only a
+        // new update adds a sample.
+        if (snap.phaseSequence != lastPhaseSequence) {
+            lastPhaseSequence = snap.phaseSequence;
+            physicsProfiler.beginFrame();
+            for (int phase = 0; phase < PHASE_UPLOAD; ++phase) {
+                physicsProfiler.add(static_cast<ProfilePhase>(phase), snap.phaseMs[phase]);
             }
+            physicsProfiler.endFrame();
         }
+        float alpha = paused ? 1.0f : snap.alpha(SimulationThread::now());
 
         // Render drag preview
         renderDragLine();
 
-        // Render lines + balls
-        for (Line* line : lines) {
-            renderLine(*line);
-        }
+        // Render every line in one draw, then every ball in one draw
+        renderLines(snap, alpha);
+        renderBalls(snap, alpha);
 
         // ImGui render
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
+        profiler.endFrame();
         glfwSwapBuffers(windowPtr);
     }
 
     // Cleanup
-    for (Line* line : lines) delete line;
+    simThread.stop();
+    simThread.simulation().clear();
 
     if (circleVBO) glDeleteBuffers(1, &circleVBO);
+    if (ballInstanceVBO) glDeleteBuffers(1, &ballInstanceVBO);
     if (circleVAO) glDeleteVertexArrays(1, &circleVAO);
 
+    releaseLineFences();
     if (lineVBO) glDeleteBuffers(1, &lineVBO);
     if (lineVAO) glDeleteVertexArrays(1, &lineVAO);
+    if (dragVBO) glDeleteBuffers(1, &dragVBO);
+    if (dragVAO) glDeleteVertexArrays(1, &dragVAO);
 
     if (shaderProgram) glDeleteProgram(shaderProgram);
+    if (ballProgram) glDeleteProgram(ballProgram);
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();